@@ -1,11 +1,22 @@
 #include "HyperDisplay_ILI9341.h"
+#include "HyperDisplay_ILI9341_BusScheduler.h"
 
 #define ARDUINO_STILL_BROKEN 1 // Referring to the epic fail that is SPI.transfer(buf, len)
 
+ILI9341_SCRATCH_ATTR static uint8_t ILI9341_defaultScratchBuff[ILI9341_SCRATCH_BYTES];
+static ILI9341_scratch_t ILI9341_defaultScratch = { ILI9341_defaultScratchBuff, ILI9341_SCRATCH_BYTES, {0}, 0, 0 };
+
 
 ILI9341::ILI9341(uint8_t xSize, uint8_t ySize, ILI9341_INTFC_t intfc ) : hyperdisplay(xSize, ySize)
 {
 	_intfc = intfc;
+	_glyphCache = NULL;
+	_scratch = &ILI9341_defaultScratch;
+	_madctl = ILI9341_MADCTL_DEFAULT;
+	_rotation = 0;
+	_nativeEndian = false;
+	_clipDepth = 0;
+	_dirtyWindow = NULL;
 }
 
 ILI9341_color_18_t ILI9341::hsvTo18b( uint16_t h, uint8_t s, uint8_t v ){
@@ -23,6 +34,172 @@ ILI9341_color_16_t ILI9341::hsvTo16b( uint16_t h, uint8_t s, uint8_t v ){
 	return rgbTo16b( r, g, b );
 }
 
+// Which channel holds the top level, the bottom level and the slope in each sextant (see fast_hsv2rgb.h)
+static const uint8_t ILI9341_sextantTop[6] = {0, 1, 1, 2, 2, 0};
+static const uint8_t ILI9341_sextantBottom[6] = {2, 2, 0, 0, 1, 1};
+static const uint8_t ILI9341_sextantSlope[6] = {1, 0, 2, 1, 0, 2};
+
+static void ILI9341_packRGB( uint8_t* pdst, uint8_t bpp, const uint8_t* rgb )
+{
+	if( bpp == 2 )
+	{
+		pdst[0] = ((rgb[0] & 0xF8) | (rgb[1] >> 5));
+		pdst[1] = (((rgb[1] & 0x1C) << 3) | (rgb[2] >> 3));
+		return;
+	}
+	pdst[0] = rgb[0];
+	pdst[1] = rgb[1];
+	pdst[2] = rgb[2];
+}
+
+static uint8_t ILI9341_hsvBottom( uint8_t s, uint8_t v )
+{
+	uint16_t ww = (v*(uint8_t)~s) + 1;
+	ww += ww >> 8;
+	return (uint8_t)(ww >> 8);
+}
+
+static uint8_t ILI9341_hsvLevel( uint16_t ww, uint8_t v )
+{
+	// Second half of the fast_hsv2rgb_8bit slope, ww is s times the distance into the sextant
+	ww += ww >> 8;
+	uint8_t bb = ~(uint8_t)(ww >> 8);
+	ww = (v*bb) + (v >> 1);
+	return (uint8_t)(ww >> 8);
+}
+
+static uint8_t ILI9341_hsvSlope( uint8_t sextant, uint8_t frac, uint8_t s, uint8_t v )
+{
+	// Same arithmetic as fast_hsv2rgb_8bit
+	uint16_t ww;
+	if( !(sextant & 0x01) ){ ww = (frac == 0) ? ((uint16_t)s << 8) : (s*(uint8_t)(-frac)); }
+	else{ ww = s*frac; }
+	return ILI9341_hsvLevel(ww, v);
+}
+
+static void ILI9341_hueSweep( uint8_t* pdst, uint8_t bpp, uint16_t count, uint16_t h0, uint32_t step, uint8_t s, uint8_t v )
+{
+	// step is in 16.16 hue units. Within a sextant the whole hue moves on by stepLo or stepLo + 1 each entry, so s times
+	// the distance into the sextant is carried exactly with an add and the slope channel matches fast_hsv2rgb_8bit
+	const uint32_t wrap = (uint32_t)HSV_HUE_STEPS << 16;
+	uint8_t rgb[3];
+	uint8_t bottom = ILI9341_hsvBottom(s, v);
+	uint16_t stepLo = (uint16_t)(step >> 16);
+	uint16_t dLo = (stepLo < 256) ? (uint16_t)(s*stepLo) : 0;		// Steps of 256 or more always land in another sextant
+	uint16_t dHi = dLo + s;
+	uint32_t hAcc = ((uint32_t)(h0 % HSV_HUE_STEPS)) << 16;
+	uint16_t hLast = 0;
+	uint16_t ww = 0;
+	uint8_t sextant = 0xFF;
+
+	for(uint16_t indi = 0; indi < count; indi++)
+	{
+		uint16_t h = hAcc >> 16;
+		if( s == 0 )
+		{
+			rgb[0] = rgb[1] = rgb[2] = v;
+		}
+		else
+		{
+			if( ((h >> 8) != sextant) || (h < hLast) )		// Re-anchored on every sextant, including a wrap back into the same one
+			{
+				sextant = h >> 8;
+				uint8_t frac = h & 0xFF;
+				ww = (sextant & 0x01) ? (uint16_t)(s*frac) : (uint16_t)(s*(256 - frac));
+			}
+			else
+			{
+				uint16_t dww = ((h - hLast) == stepLo) ? dLo : dHi;
+				ww = (sextant & 0x01) ? (ww + dww) : (ww - dww);
+			}
+			hLast = h;
+			rgb[ILI9341_sextantTop[sextant]] = v;
+			rgb[ILI9341_sextantBottom[sextant]] = bottom;
+			rgb[ILI9341_sextantSlope[sextant]] = ILI9341_hsvLevel(ww, v);
+		}
+		ILI9341_packRGB(pdst, bpp, rgb);
+		pdst += bpp;
+
+		hAcc += step;
+		while( hAcc >= wrap ){ hAcc -= wrap; }
+	}
+}
+
+static void ILI9341_hsvSweep( uint8_t* pdst, uint8_t bpp, uint16_t count, uint16_t h0, uint8_t s0, uint8_t v0, uint16_t h1, uint8_t s1, uint8_t v1 )
+{
+	const uint32_t wrap = (uint32_t)HSV_HUE_STEPS << 16;
+	uint32_t span = ((uint32_t)h1 + HSV_HUE_STEPS - (h0 % HSV_HUE_STEPS)) % HSV_HUE_STEPS;
+	uint16_t div = (count > 1) ? (count - 1) : 1;
+	uint32_t hStep = (span << 16)/div;
+	int32_t sStep = (((int32_t)s1 - s0) << 16)/div;
+	int32_t vStep = (((int32_t)v1 - v0) << 16)/div;
+	uint32_t hAcc = ((uint32_t)(h0 % HSV_HUE_STEPS)) << 16;
+	int32_t sAcc = ((int32_t)s0 << 16) + 0x8000;
+	int32_t vAcc = ((int32_t)v0 << 16) + 0x8000;
+	uint8_t rgb[3];
+
+	for(uint16_t indi = 0; indi < count; indi++)
+	{
+		uint16_t h = hAcc >> 16;
+		uint8_t s = (uint8_t)(sAcc >> 16);
+		uint8_t v = (uint8_t)(vAcc >> 16);
+		if( s == 0 )
+		{
+			rgb[0] = rgb[1] = rgb[2] = v;
+		}
+		else
+		{
+			uint8_t sextant = h >> 8;
+			rgb[ILI9341_sextantTop[sextant]] = v;
+			rgb[ILI9341_sextantBottom[sextant]] = ILI9341_hsvBottom(s, v);
+			rgb[ILI9341_sextantSlope[sextant]] = ILI9341_hsvSlope(sextant, h & 0xFF, s, v);
+		}
+		ILI9341_packRGB(pdst, bpp, rgb);
+		pdst += bpp;
+
+		hAcc += hStep;
+		while( hAcc >= wrap ){ hAcc -= wrap; }
+		sAcc += sStep;
+		vAcc += vStep;
+	}
+}
+
+static uint32_t ILI9341_hueRampStep( uint16_t count, uint16_t h0, uint16_t h1 )
+{
+	uint32_t span = ((uint32_t)h1 + HSV_HUE_STEPS - (h0 % HSV_HUE_STEPS)) % HSV_HUE_STEPS;
+	return (count > 1) ? ((span << 16)/(count - 1)) : 0;
+}
+
+void ILI9341::hueRamp18b( ILI9341_color_18_t* pdst, uint16_t count, uint16_t h0, uint16_t h1, uint8_t s, uint8_t v ){
+	if( pdst == NULL ){ return; }
+	ILI9341_hueSweep((uint8_t*)pdst, sizeof(ILI9341_color_18_t), count, h0, ILI9341_hueRampStep(count, h0, h1), s, v);
+}
+
+void ILI9341::hueRamp16b( ILI9341_color_16_t* pdst, uint16_t count, uint16_t h0, uint16_t h1, uint8_t s, uint8_t v ){
+	if( pdst == NULL ){ return; }
+	ILI9341_hueSweep((uint8_t*)pdst, sizeof(ILI9341_color_16_t), count, h0, ILI9341_hueRampStep(count, h0, h1), s, v);
+}
+
+void ILI9341::hueWheel18b( ILI9341_color_18_t* pdst, uint16_t count, uint8_t s, uint8_t v ){
+	if((pdst == NULL) || (count == 0)){ return; }
+	ILI9341_hueSweep((uint8_t*)pdst, sizeof(ILI9341_color_18_t), count, 0, ((uint32_t)HSV_HUE_STEPS << 16)/count, s, v);
+}
+
+void ILI9341::hueWheel16b( ILI9341_color_16_t* pdst, uint16_t count, uint8_t s, uint8_t v ){
+	if((pdst == NULL) || (count == 0)){ return; }
+	ILI9341_hueSweep((uint8_t*)pdst, sizeof(ILI9341_color_16_t), count, 0, ((uint32_t)HSV_HUE_STEPS << 16)/count, s, v);
+}
+
+void ILI9341::hsvRamp18b( ILI9341_color_18_t* pdst, uint16_t count, uint16_t h0, uint8_t s0, uint8_t v0, uint16_t h1, uint8_t s1, uint8_t v1 ){
+	if( pdst == NULL ){ return; }
+	ILI9341_hsvSweep((uint8_t*)pdst, sizeof(ILI9341_color_18_t), count, h0, s0, v0, h1, s1, v1);
+}
+
+void ILI9341::hsvRamp16b( ILI9341_color_16_t* pdst, uint16_t count, uint16_t h0, uint8_t s0, uint8_t v0, uint16_t h1, uint8_t s1, uint8_t v1 ){
+	if( pdst == NULL ){ return; }
+	ILI9341_hsvSweep((uint8_t*)pdst, sizeof(ILI9341_color_16_t), count, h0, s0, v0, h1, s1, v1);
+}
+
 ILI9341_color_18_t ILI9341::rgbTo18b( uint8_t r, uint8_t g, uint8_t b ){
 	ILI9341_color_18_t retval;
 	retval.r = r;
@@ -38,6 +215,10 @@ ILI9341_color_16_t ILI9341::rgbTo16b( uint8_t r, uint8_t g, uint8_t b ){
 	return retval;
 }
 
+uint16_t ILI9341::rgbTo565( uint8_t r, uint8_t g, uint8_t b ){
+	return (((uint16_t)(r & 0xF8) << 8) | ((uint16_t)(g & 0xFC) << 3) | (b >> 3));
+}
+
 
 
 
@@ -60,6 +241,102 @@ uint8_t ILI9341::getBytesPerPixel( void )
 	return bpp;
 }
 
+ILI9341_STAT_t ILI9341::setScratchBuffer( uint8_t* buff, size_t size )
+{
+	if( buff == NULL )
+	{
+		_scratch = &ILI9341_defaultScratch;
+		return ILI9341_STAT_Nominal;
+	}
+	if( size < ILI9341_MAX_BPP ){ return ILI9341_STAT_Error; }	// Has to hold at least one pixel of any format
+
+	_userScratch.buff = buff;
+	_userScratch.size = size;
+	_userScratch.colorBpp = 0;
+	_userScratch.colorPixels = 0;
+	_scratch = &_userScratch;
+	return ILI9341_STAT_Nominal;
+}
+
+uint8_t* ILI9341::getScratch( size_t* size )
+{
+	_scratch->colorBpp = 0;		// The caller is about to overwrite whatever color was cached
+	if( size != NULL ){ *size = _scratch->size; }
+	return _scratch->buff;
+}
+
+uint8_t* ILI9341::replicateColor( color_t color, hd_pixels_t* numPixels )
+{
+	uint8_t bpp = getBytesPerPixel( );
+	if((bpp == 0) || (color == NULL) || (numPixels == NULL)){ return NULL; }
+
+	hd_pixels_t capacity = _scratch->size/bpp;
+	if( *numPixels > capacity ){ *numPixels = capacity; }
+
+	if( (_scratch->colorBpp != bpp) || (memcmp(_scratch->color, color, bpp) != 0) )
+	{
+		memcpy(_scratch->color, color, bpp);	// Cached as the caller passed it, the arena holds it in wire order
+		loadPixel(_scratch->buff, color);
+		_scratch->colorBpp = bpp;
+		_scratch->colorPixels = 1;
+	}
+
+	// Double up whatever is already in place rather than copying a pixel at a time
+	while( _scratch->colorPixels < *numPixels )
+	{
+		hd_pixels_t copyPixels = *numPixels - _scratch->colorPixels;
+		if( copyPixels > _scratch->colorPixels ){ copyPixels = _scratch->colorPixels; }
+		memcpy(_scratch->buff + ((size_t)_scratch->colorPixels*bpp), _scratch->buff, (size_t)copyPixels*bpp);
+		_scratch->colorPixels += copyPixels;
+	}
+	return _scratch->buff;
+}
+
+void ILI9341::setNativeEndian( bool native )
+{
+	if( native != _nativeEndian ){ _scratch->colorBpp = 0; }	// A cached color would be in the wrong order
+	_nativeEndian = native;
+}
+
+bool ILI9341::getNativeEndian( void )
+{
+	return _nativeEndian;
+}
+
+void ILI9341::loadPixel( uint8_t* pdst, color_t color )
+{
+	uint8_t bpp = getBytesPerPixel( );
+	if( _nativeEndian && (bpp == 2) )
+	{
+		uint16_t value;
+		memcpy(&value, color, sizeof(value));
+		pdst[0] = (uint8_t)(value >> 8);
+		pdst[1] = (uint8_t)value;
+		return;
+	}
+	memcpy(pdst, color, bpp);
+}
+
+void ILI9341::swap565( uint8_t* pdata, hd_pixels_t numPixels )
+{
+	// Two pixels per word - compilers turn the mask and shift into rev16 or a vector shuffle where the target has one
+	size_t numWords = numPixels/2;
+	for(size_t indi = 0; indi < numWords; indi++)
+	{
+		uint32_t word;
+		memcpy(&word, pdata, sizeof(word));
+		word = ((word & 0x00FF00FFUL) << 8) | ((word >> 8) & 0x00FF00FFUL);
+		memcpy(pdata, &word, sizeof(word));
+		pdata += sizeof(word);
+	}
+	if( numPixels & 0x01 )
+	{
+		uint8_t temp = pdata[0];
+		pdata[0] = pdata[1];
+		pdata[1] = temp;
+	}
+}
+
 
 // Pure virtual functions from HyperDisplay Implemented:
 color_t ILI9341::getOffsetColor(color_t base, uint32_t numPixels)
@@ -83,14 +360,20 @@ void 	ILI9341::hwpixel(hd_hw_extent_t x0, hd_hw_extent_t y0, color_t data, hd_co
 {
 	if(data == NULL){ return; }
 
+	hd_hw_extent_t x1 = x0;
+	hd_hw_extent_t y1 = y0;
+	if( !clipWindow(&x0, &y0, &x1, &y1) ){ return; }
+
 	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 0);	// This line is needed to condition the user's input start color offset
 	color_t value = getOffsetColor(data, startColorOffset);
 
 	setColumnAddress( (uint16_t)x0, (uint16_t)x0);
 	setRowAddress( (uint16_t)y0, (uint16_t)y0);
 	uint8_t len = getBytesPerPixel( );
+	uint8_t pixel[ILI9341_MAX_BPP];
+	loadPixel(pixel, value);
 
-	writeToRAM( (uint8_t*)value, len );
+	writeToRAM( pixel, len );
 }
 
 void	ILI9341::swpixel( hd_extent_t x0, hd_extent_t y0, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset)
@@ -109,6 +392,230 @@ void	ILI9341::swpixel( hd_extent_t x0, hd_extent_t y0, color_t data, hd_colors_t
 	uint32_t len = (uint32_t)getOffsetColor(0x00, 1);				// Getting the offset from zero for one pixel tells us how many bytes to copy
 
 	memcpy((void*)dest, (void*)value, (size_t)len);		// Copy data into the window's buffer
+	markDirtyRows(y0w, y0w);
+}
+
+static void ILI9341_replicate( uint8_t* pdst, const uint8_t* color, hd_pixels_t numPixels, uint8_t bpp )
+{
+	// Lay down one pixel and double it, so nearly all of the work is done by memcpy a word (or more) at a time
+	memcpy(pdst, color, bpp);
+	size_t filled = bpp;
+	size_t total = (size_t)numPixels*bpp;
+	while( filled < total )
+	{
+		size_t copyBytes = ((total - filled) > filled) ? filled : (total - filled);
+		memcpy(pdst + filled, pdst, copyBytes);
+		filled += copyBytes;
+	}
+}
+
+void ILI9341::markDirtyRows( hd_hw_extent_t y0, hd_hw_extent_t y1 )
+{
+	if( pCurrentWindow != _dirtyWindow )
+	{
+		// Whatever was drawn into this window while another one was tracked is unknown, so start from all dirty
+		_dirtyWindow = pCurrentWindow;
+		memset(_dirtyRows, 0xFF, sizeof(_dirtyRows));
+		return;
+	}
+	if( y1 >= ILI9341_MAX_Y ){ y1 = ILI9341_MAX_Y - 1; }
+	for(hd_hw_extent_t row = y0; row <= y1; row++)
+	{
+		_dirtyRows[row >> 3] |= (uint8_t)(1 << (row & 0x07));
+	}
+}
+
+void ILI9341::swxline( hd_extent_t x0, hd_extent_t y0, hd_extent_t len, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool goLeft)
+{
+	if(data == NULL){ return; }
+	if(colorCycleLength == 0){ return; }
+	uint8_t bpp = getBytesPerPixel( );
+	if((bpp == 0) || (pCurrentWindow->data == NULL)){ return; }
+
+	int32_t x = (int32_t)x0;
+	int32_t y = (int32_t)y0;
+	int32_t n = (int32_t)len;
+	int32_t width = (pCurrentWindow->xMax - pCurrentWindow->xMin) + 1;
+	int32_t height = (pCurrentWindow->yMax - pCurrentWindow->yMin) + 1;
+	if((n < 1) || (y < 0) || (y >= height) || (x < 0) || (x >= width)){ return; }
+	if( goLeft ){ if( n > x + 1 ){ n = x + 1; } }
+	else{ if( n > width - x ){ n = width - x; } }
+
+	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 0);
+	uint8_t* prow = (uint8_t*)pCurrentWindow->data + ((size_t)y*width*bpp);
+
+	if( colorCycleLength == 1 )
+	{
+		// One color doesn't care about direction
+		int32_t xs = goLeft ? (x - (n - 1)) : x;
+		ILI9341_replicate(prow + ((size_t)xs*bpp), (const uint8_t*)data, n, bpp);
+	}
+	else if( !goLeft )
+	{
+		// Copy the cycle a segment at a time
+		uint8_t* pdst = prow + ((size_t)x*bpp);
+		while( n > 0 )
+		{
+			int32_t count = colorCycleLength - startColorOffset;
+			if( count > n ){ count = n; }
+			memcpy(pdst, getOffsetColor(data, startColorOffset), (size_t)count*bpp);
+			pdst += (size_t)count*bpp;
+			n -= count;
+			startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, count);
+		}
+	}
+	else
+	{
+		uint8_t* pdst = prow + ((size_t)x*bpp);
+		for(int32_t indi = 0; indi < n; indi++)
+		{
+			memcpy(pdst, getOffsetColor(data, startColorOffset), bpp);
+			pdst -= bpp;
+			startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 1);
+		}
+	}
+	markDirtyRows((hd_hw_extent_t)y, (hd_hw_extent_t)y);
+}
+
+void ILI9341::swyline( hd_extent_t x0, hd_extent_t y0, hd_extent_t len, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool goUp)
+{
+	if(data == NULL){ return; }
+	if(colorCycleLength == 0){ return; }
+	uint8_t bpp = getBytesPerPixel( );
+	if((bpp == 0) || (pCurrentWindow->data == NULL)){ return; }
+
+	int32_t x = (int32_t)x0;
+	int32_t y = (int32_t)y0;
+	int32_t n = (int32_t)len;
+	int32_t width = (pCurrentWindow->xMax - pCurrentWindow->xMin) + 1;
+	int32_t height = (pCurrentWindow->yMax - pCurrentWindow->yMin) + 1;
+	if((n < 1) || (x < 0) || (x >= width) || (y < 0) || (y >= height)){ return; }
+	if( goUp ){ if( n > y + 1 ){ n = y + 1; } }
+	else{ if( n > height - y ){ n = height - y; } }
+
+	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 0);
+	ptrdiff_t stride = goUp ? -((ptrdiff_t)width*bpp) : ((ptrdiff_t)width*bpp);
+	uint8_t* pdst = (uint8_t*)pCurrentWindow->data + (((size_t)y*width + x)*bpp);
+	for(int32_t indi = 0; indi < n; indi++)
+	{
+		const uint8_t* psrc = (const uint8_t*)getOffsetColor(data, startColorOffset);
+		if( bpp == 2 ){ pdst[0] = psrc[0]; pdst[1] = psrc[1]; }
+		else{ memcpy(pdst, psrc, bpp); }
+		pdst += stride;
+		if( colorCycleLength != 1 ){ startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 1); }
+	}
+	int32_t ya = goUp ? (y - (n - 1)) : y;
+	int32_t yb = goUp ? y : (y + (n - 1));
+	markDirtyRows((hd_hw_extent_t)ya, (hd_hw_extent_t)yb);
+}
+
+void ILI9341::swrectangle( hd_extent_t x0, hd_extent_t y0, hd_extent_t x1, hd_extent_t y1, bool filled, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool reverseGradient, bool gradientVertical)
+{
+	if(data == NULL){ return; }
+	uint8_t bpp = getBytesPerPixel( );
+
+	// Outlines and gradients come back through swxline and swyline
+	if( !filled || (colorCycleLength != 1) || (bpp == 0) || (pCurrentWindow->data == NULL) )
+	{
+		hyperdisplay::swrectangle(x0, y0, x1, y1, filled, data, colorCycleLength, startColorOffset, reverseGradient, gradientVertical);
+		return;
+	}
+
+	int32_t xa = (int32_t)x0, xb = (int32_t)x1;
+	int32_t ya = (int32_t)y0, yb = (int32_t)y1;
+	if( xb < xa ){ int32_t temp = xa; xa = xb; xb = temp; }
+	if( yb < ya ){ int32_t temp = ya; ya = yb; yb = temp; }
+	int32_t width = (pCurrentWindow->xMax - pCurrentWindow->xMin) + 1;
+	int32_t height = (pCurrentWindow->yMax - pCurrentWindow->yMin) + 1;
+	if( xa < 0 ){ xa = 0; }
+	if( ya < 0 ){ ya = 0; }
+	if( xb >= width ){ xb = width - 1; }
+	if( yb >= height ){ yb = height - 1; }
+	if((xa > xb) || (ya > yb)){ return; }
+
+	// Fill the first row, then copy it down
+	size_t rowBytes = (size_t)((xb - xa) + 1)*bpp;
+	size_t stride = (size_t)width*bpp;
+	uint8_t* pfirst = (uint8_t*)pCurrentWindow->data + (((size_t)ya*width + xa)*bpp);
+	ILI9341_replicate(pfirst, (const uint8_t*)data, (xb - xa) + 1, bpp);
+	uint8_t* pdst = pfirst + stride;
+	for(int32_t row = ya + 1; row <= yb; row++)
+	{
+		memcpy(pdst, pfirst, rowBytes);
+		pdst += stride;
+	}
+	markDirtyRows((hd_hw_extent_t)ya, (hd_hw_extent_t)yb);
+}
+
+void ILI9341::swfillFromArray( hd_extent_t x0, hd_extent_t y0, hd_extent_t x1, hd_extent_t y1, color_t data, hd_pixels_t numPixels, bool Vh)
+{
+	if((data == NULL) || (numPixels == 0)){ return; }
+	uint8_t bpp = getBytesPerPixel( );
+	if( Vh || (bpp == 0) || (pCurrentWindow->data == NULL) )
+	{
+		hyperdisplay::swfillFromArray(x0, y0, x1, y1, data, numPixels, Vh);
+		return;
+	}
+
+	int32_t xa = (int32_t)x0, xb = (int32_t)x1;
+	int32_t ya = (int32_t)y0, yb = (int32_t)y1;
+	if( xb < xa ){ int32_t temp = xa; xa = xb; xb = temp; }
+	if( yb < ya ){ int32_t temp = ya; ya = yb; yb = temp; }
+	int32_t srcWidth = (xb - xa) + 1;
+	int32_t width = (pCurrentWindow->xMax - pCurrentWindow->xMin) + 1;
+	int32_t height = (pCurrentWindow->yMax - pCurrentWindow->yMin) + 1;
+
+	// Source rows keep their full stride even when the window cuts them short
+	int32_t skipX = (xa < 0) ? -xa : 0;
+	int32_t skipY = (ya < 0) ? -ya : 0;
+	int32_t xe = (xb >= width) ? (width - 1) : xb;
+	int32_t ye = (yb >= height) ? (height - 1) : yb;
+	xa += skipX;
+	ya += skipY;
+	if((xa > xe) || (ya > ye)){ return; }
+
+	hd_pixels_t offset = ((hd_pixels_t)skipY*srcWidth) + skipX;
+	uint8_t* pdst = (uint8_t*)pCurrentWindow->data + (((size_t)ya*width + xa)*bpp);
+	int32_t row = ya;
+	for( ; (row <= ye) && (offset < numPixels); row++)
+	{
+		hd_pixels_t count = (xe - xa) + 1;
+		if( count > (numPixels - offset) ){ count = numPixels - offset; }
+		memcpy(pdst, getOffsetColor(data, offset), (size_t)count*bpp);
+		pdst += (size_t)width*bpp;
+		offset += srcWidth;
+	}
+	if( row > ya ){ markDirtyRows((hd_hw_extent_t)ya, (hd_hw_extent_t)(row - 1)); }
+}
+
+ILI9341_STAT_t ILI9341::showWindow( wind_info_t* wind )
+{
+	if( wind == NULL ){ wind = pCurrentWindow; }
+	if((wind == NULL) || (wind->data == NULL) || !wind->bufferMode){ return ILI9341_STAT_Error; }
+
+	hd_hw_extent_t width = (wind->xMax - wind->xMin) + 1;
+	hd_hw_extent_t height = (wind->yMax - wind->yMin) + 1;
+	if( wind != _dirtyWindow )
+	{
+		hwfillFromArray(wind->xMin, wind->yMin, wind->xMax, wind->yMax, wind->data, (hd_pixels_t)width*height);
+		return ILI9341_STAT_Nominal;
+	}
+
+	hd_hw_extent_t row = 0;
+	while( row < height )
+	{
+		if( !(_dirtyRows[row >> 3] & (1 << (row & 0x07))) )
+		{
+			if( _dirtyRows[row >> 3] == 0x00 ){ row = (row | 0x07) + 1; }	// Skip clean rows eight at a time
+			else{ row++; }
+			continue;
+		}
+		hd_hw_extent_t start = row;
+		while( (row < height) && (_dirtyRows[row >> 3] & (1 << (row & 0x07))) ){ row++; }
+		hwfillFromArray(wind->xMin, wind->yMin + start, wind->xMax, wind->yMin + (row - 1), getOffsetColor(wind->data, (hd_pixels_t)start*width), (hd_pixels_t)(row - start)*width);
+	}
+	memset(_dirtyRows, 0x00, sizeof(_dirtyRows));
+	return ILI9341_STAT_Nominal;
 }
 
 
@@ -197,19 +704,534 @@ ILI9341_STAT_t ILI9341::setRowAddress( uint16_t start, uint16_t end )
 {
 	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
 
-	ILI9341_CMD_t cmd = ILI9341_CMD_RASET;
-	uint8_t buff[4] = {(start >> 8), (start & 0x00FF), (end >> 8), (end & 0x00FF)};
-	retval = writePacket(&cmd, buff, 4);
-	return retval;
+	ILI9341_CMD_t cmd = ILI9341_CMD_RASET;
+	uint8_t buff[4] = {(start >> 8), (start & 0x00FF), (end >> 8), (end & 0x00FF)};
+	retval = writePacket(&cmd, buff, 4);
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341::writeToRAM( uint8_t* pdata, uint16_t numBytes )
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+
+	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
+	retval = writePacket(&cmd, pdata, numBytes);
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341::readPacket(ILI9341_CMD_t*, uint8_t*, uint16_t, uint8_t)
+{
+	return ILI9341_STAT_Error;
+}
+
+ILI9341_STAT_t ILI9341::readRAM( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, uint8_t* pdata, hd_pixels_t numPixels )
+{
+	if((pdata == NULL) || (numPixels == 0)){ return ILI9341_STAT_Error; }
+
+	ILI9341_STAT_t retval = setWindow( x0, y0, x1, y1 );
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+
+	// Each read command (and read memory continue) starts with a dummy byte
+	ILI9341_CMD_t cmd = ILI9341_CMD_RDRAM;
+	size_t numBytes = (size_t)numPixels*3;
+	while( numBytes )
+	{
+		uint16_t chunk = (numBytes > 0xFFFF) ? 0xFFFF : (uint16_t)numBytes;	// 0xFFFF is a whole number of pixels
+		retval = readPacket(&cmd, pdata, chunk, 1);
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+		cmd = ILI9341_CMD_RDRAMCONT;
+		pdata += chunk;
+		numBytes -= chunk;
+	}
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341::setWindow( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1 )
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+
+	retval = setColumnAddress( (uint16_t)x0, (uint16_t)x1 );
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	retval = setRowAddress( (uint16_t)y0, (uint16_t)y1 );
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341::startRAMWrite( void )
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+
+	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
+	retval = writePacket(&cmd);			// Data packets that follow without a command keep writing into the window
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341::continueRAMWrite( uint8_t* pdata, size_t numBytes )
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+
+	while( numBytes )
+	{
+		uint16_t chunk = (numBytes > 0xFFFF) ? 0xFFFF : (uint16_t)numBytes;	// writePacket can only take 16 bits worth of length
+		retval = writePacket(NULL, pdata, chunk);
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+		pdata += chunk;
+		numBytes -= chunk;
+	}
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341::continuePixelWrite( const uint8_t* pdata, hd_pixels_t numPixels )
+{
+	uint8_t bpp = getBytesPerPixel( );
+	if( bpp == 0 ){ return ILI9341_STAT_Error; }
+	if( !(_nativeEndian && (bpp == 2)) ){ return continueRAMWrite((uint8_t*)pdata, (size_t)numPixels*bpp); }
+
+	// The application's array is left alone - swap a chunk at a time through the arena
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	size_t size = 0;
+	uint8_t* swapBuff = getScratch(&size);
+	hd_pixels_t chunkPixels = size/bpp;
+	while( numPixels != 0 )
+	{
+		hd_pixels_t pixelsToDraw = (numPixels > chunkPixels) ? chunkPixels : numPixels;
+		memcpy(swapBuff, pdata, (size_t)pixelsToDraw*bpp);
+		swap565(swapBuff, pixelsToDraw);
+		retval = continueRAMWrite(swapBuff, (size_t)pixelsToDraw*bpp);
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+		pdata += (size_t)pixelsToDraw*bpp;
+		numPixels -= pixelsToDraw;
+	}
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341::stopRAMWrite( void )
+{
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341::waitForBus( void )
+{
+	return ILI9341_STAT_Nominal;	// writePacket is blocking so the bus is already free
+}
+
+ILI9341_STAT_t ILI9341::startBatch( void )
+{
+	return ILI9341_STAT_Nominal;	// Nothing to hold on backends without per packet setup
+}
+
+ILI9341_STAT_t ILI9341::stopBatch( void )
+{
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341::streamColorCycle( color_t data, hd_pixels_t numPixels, hd_colors_t colorCycleLength, hd_colors_t startColorOffset )
+{
+	if(data == NULL){ return ILI9341_STAT_Error; }
+	if(colorCycleLength == 0){ return ILI9341_STAT_Error; }
+
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	uint8_t bpp = getBytesPerPixel( );
+	if( bpp == 0 ){ return ILI9341_STAT_Error; }
+
+	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 0);	// This line is needed to condition the user's input start color offset
+
+	if( colorCycleLength == 1 )
+	{
+		// Special case that can be handled with a lot less thinking (so faster) - and repeats of the same color skip the fill
+		hd_pixels_t chunkPixels = numPixels;
+		uint8_t* colorBuff = replicateColor(data, &chunkPixels);
+		while( numPixels != 0 )
+		{
+			hd_pixels_t pixelsToDraw = (numPixels > chunkPixels) ? chunkPixels : numPixels;
+			retval = continueRAMWrite(colorBuff, (size_t)pixelsToDraw*bpp);
+			if( retval != ILI9341_STAT_Nominal ){ return retval; }
+			numPixels -= pixelsToDraw;
+		}
+		return retval;
+	}
+
+	hd_pixels_t capacity = _scratch->size/bpp;
+
+	if( colorCycleLength > capacity )
+	{
+		// Each segment of a cycle this long is already a large transfer, so send straight from the user's data
+		while( numPixels != 0 )
+		{
+			hd_pixels_t pixelsToDraw = colorCycleLength - startColorOffset;
+			if( pixelsToDraw > numPixels ){ pixelsToDraw = numPixels; }
+			retval = continuePixelWrite((const uint8_t*)getOffsetColor(data, startColorOffset), pixelsToDraw);
+			if( retval != ILI9341_STAT_Nominal ){ return retval; }
+			numPixels -= pixelsToDraw;
+			startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, pixelsToDraw);
+		}
+		return retval;
+	}
+
+	// Lay the cycle down once, rotated so it starts at the offset, then double it up to as many whole cycles as fit
+	uint8_t* cycleBuff = getScratch(NULL);
+	size_t cycleBytes = (size_t)colorCycleLength*bpp;
+	size_t headBytes = (size_t)(colorCycleLength - startColorOffset)*bpp;
+	memcpy(cycleBuff, getOffsetColor(data, startColorOffset), headBytes);
+	memcpy(cycleBuff + headBytes, data, cycleBytes - headBytes);
+	if( _nativeEndian && (bpp == 2) ){ swap565(cycleBuff, colorCycleLength); }
+
+	hd_pixels_t chunkPixels = (capacity/colorCycleLength)*colorCycleLength;
+	if( chunkPixels > numPixels ){ chunkPixels = ((numPixels + colorCycleLength - 1)/colorCycleLength)*colorCycleLength; }
+	size_t filledBytes = cycleBytes;
+	while( filledBytes < (size_t)chunkPixels*bpp )
+	{
+		size_t copyBytes = ((size_t)chunkPixels*bpp) - filledBytes;
+		if( copyBytes > filledBytes ){ copyBytes = filledBytes; }
+		memcpy(cycleBuff + filledBytes, cycleBuff, copyBytes);
+		filledBytes += copyBytes;
+	}
+
+	// Whole chunks always end on a cycle boundary so every chunk can start from the beginning of the buffer
+	while( numPixels != 0 )
+	{
+		hd_pixels_t pixelsToDraw = (numPixels > chunkPixels) ? chunkPixels : numPixels;
+		retval = continueRAMWrite(cycleBuff, (size_t)pixelsToDraw*bpp);
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+		numPixels -= pixelsToDraw;
+	}
+	return retval;
+}
+
+
+static void ILI9341_expandRow( uint8_t* pdst, const uint8_t* prow, hd_hw_extent_t dx, hd_hw_extent_t count, hd_hw_extent_t srcWidth, hd_hw_extent_t dstWidth, uint8_t bpp )
+{
+	// Step through the source with an error term instead of dividing for every pixel
+	uint32_t pos = (uint32_t)dx*srcWidth;
+	hd_hw_extent_t sx = pos/dstWidth;
+	uint32_t err = pos % dstWidth;
+	const uint8_t* psrc = prow + ((size_t)sx*bpp);
+	for(hd_hw_extent_t indi = 0; indi < count; indi++)
+	{
+		if( bpp == 2 )
+		{
+			*(pdst++) = psrc[0];
+			*(pdst++) = psrc[1];
+		}
+		else
+		{
+			memcpy(pdst, psrc, bpp);
+			pdst += bpp;
+		}
+		err += srcWidth;
+		while( err >= dstWidth )
+		{
+			err -= dstWidth;
+			psrc += bpp;
+		}
+	}
+}
+
+ILI9341_STAT_t ILI9341::hwfillFromArrayScaled( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data, hd_hw_extent_t srcWidth, hd_hw_extent_t srcHeight )
+{
+	if((data == NULL) || (srcWidth == 0) || (srcHeight == 0)){ return ILI9341_STAT_Error; }
+
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	uint8_t bpp = getBytesPerPixel( );
+	if( bpp == 0 ){ return ILI9341_STAT_Error; }
+
+	if( x1 < x0 ){ hd_hw_extent_t temp = x0; x0 = x1; x1 = temp; }
+	if( y1 < y0 ){ hd_hw_extent_t temp = y0; y0 = y1; y1 = temp; }
+	hd_hw_extent_t dstWidth = (x1 - x0) + 1;
+	hd_hw_extent_t dstHeight = (y1 - y0) + 1;
+
+	// The stretch is still worked out over the whole window, only the visible part of it is sent
+	hd_hw_extent_t cx0 = x0;
+	hd_hw_extent_t cy0 = y0;
+	hd_hw_extent_t cx1 = x1;
+	hd_hw_extent_t cy1 = y1;
+	if( !clipWindow(&cx0, &cy0, &cx1, &cy1) ){ return ILI9341_STAT_Nominal; }
+	hd_hw_extent_t dxStart = cx0 - x0;
+	hd_hw_extent_t dxEnd = (cx1 - x0) + 1;
+
+	size_t size = 0;
+	uint8_t* rowBuff = getScratch(&size);
+	hd_pixels_t chunkPixels = size/bpp;
+	if( chunkPixels == 0 ){ return ILI9341_STAT_Error; }
+	size_t rowBytes = (size_t)(dxEnd - dxStart)*bpp;
+	bool wholeRow = (rowBytes <= size);		// Then a stretched row can be sent again for each vertical repeat
+
+	retval = setWindow(cx0, cy0, cx1, cy1);
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	startRAMWrite();
+
+	int32_t lastRow = -1;
+	for(hd_hw_extent_t dy = (cy0 - y0); dy <= (hd_hw_extent_t)(cy1 - y0); dy++)
+	{
+		hd_hw_extent_t sy = ((uint32_t)dy*srcHeight)/dstHeight;
+		if( wholeRow && ((int32_t)sy == lastRow) )
+		{
+			retval = continueRAMWrite(rowBuff, rowBytes);
+			if( retval != ILI9341_STAT_Nominal ){ break; }
+			continue;
+		}
+
+		const uint8_t* prow = (const uint8_t*)data + ((size_t)sy*srcWidth*bpp);
+		for(hd_hw_extent_t dx = dxStart; dx < dxEnd; )
+		{
+			hd_hw_extent_t count = ((hd_pixels_t)(dxEnd - dx) > chunkPixels) ? (hd_hw_extent_t)chunkPixels : (dxEnd - dx);
+			ILI9341_expandRow(rowBuff, prow, dx, count, srcWidth, dstWidth, bpp);
+			if( _nativeEndian && (bpp == 2) ){ swap565(rowBuff, count); }
+			retval = continueRAMWrite(rowBuff, (size_t)count*bpp);
+			if( retval != ILI9341_STAT_Nominal ){ break; }
+			dx += count;
+		}
+		if( retval != ILI9341_STAT_Nominal ){ break; }
+		lastRow = sy;
+	}
+	stopRAMWrite();
+	return retval;
+}
+
+// Clipping
+ILI9341_STAT_t ILI9341::pushClip( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1 )
+{
+	if( _clipDepth >= ILI9341_CLIP_DEPTH ){ return ILI9341_STAT_Error; }
+	if( x1 < x0 ){ hd_hw_extent_t temp = x0; x0 = x1; x1 = temp; }
+	if( y1 < y0 ){ hd_hw_extent_t temp = y0; y0 = y1; y1 = temp; }
+
+	ILI9341_clip_t* clip = &_clipStack[_clipDepth];
+	clip->x0 = x0;
+	clip->y0 = y0;
+	clip->x1 = x1;
+	clip->y1 = y1;
+	if( _clipDepth != 0 )
+	{
+		const ILI9341_clip_t* below = &_clipStack[_clipDepth - 1];
+		if( below->x0 > clip->x0 ){ clip->x0 = below->x0; }
+		if( below->y0 > clip->y0 ){ clip->y0 = below->y0; }
+		if( below->x1 < clip->x1 ){ clip->x1 = below->x1; }
+		if( below->y1 < clip->y1 ){ clip->y1 = below->y1; }
+	}
+	if((clip->x0 > clip->x1) || (clip->y0 > clip->y1))
+	{
+		clip->x0 = 1;		// Disjoint, so everything drawn until the matching pop is dropped
+		clip->x1 = 0;
+	}
+	_clipDepth++;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341::popClip( void )
+{
+	if( _clipDepth == 0 ){ return ILI9341_STAT_Error; }
+	_clipDepth--;
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341::resetClip( void )
+{
+	_clipDepth = 0;
+}
+
+bool ILI9341::getClip( ILI9341_clip_t* clip )
+{
+	if( _clipDepth == 0 ){ return false; }
+	if( clip != NULL ){ *clip = _clipStack[_clipDepth - 1]; }
+	return true;
+}
+
+bool ILI9341::clipWindow( hd_hw_extent_t* x0, hd_hw_extent_t* y0, hd_hw_extent_t* x1, hd_hw_extent_t* y1 )
+{
+	if( _clipDepth == 0 ){ return true; }
+	const ILI9341_clip_t* clip = &_clipStack[_clipDepth - 1];
+	if( clip->x0 > clip->x1 ){ return false; }
+	if((*x1 < clip->x0) || (*x0 > clip->x1) || (*y1 < clip->y0) || (*y0 > clip->y1)){ return false; }
+	if( *x0 < clip->x0 ){ *x0 = clip->x0; }
+	if( *y0 < clip->y0 ){ *y0 = clip->y0; }
+	if( *x1 > clip->x1 ){ *x1 = clip->x1; }
+	if( *y1 > clip->y1 ){ *y1 = clip->y1; }
+	return true;
+}
+
+// Text
+void ILI9341::setGlyphCache( ILI9341_glyph_cache_t* cache )
+{
+	_glyphCache = cache;
+	clearGlyphCache();
+}
+
+void ILI9341::clearGlyphCache( void )
+{
+	if( _glyphCache == NULL ){ return; }
+	for(uint8_t indi = 0; indi < ILI9341_GLYPH_CACHE_SIZE; indi++)
+	{
+		_glyphCache->glyphs[indi].valid = false;
+	}
+}
+
+bool ILI9341::expandGlyph( uint8_t code, ILI9341_glyph_t* glyph )
+{
+	char_info_t info;
+	getCharInfo(code, &info);		// Whatever font the derived class provides, as a list of pixel locations
+
+	glyph->code = code;
+	glyph->width = ((int32_t)info.xDim > ILI9341_GLYPH_MAX_W) ? ILI9341_GLYPH_MAX_W : (uint8_t)info.xDim;
+	glyph->height = ((int32_t)info.yDim > ILI9341_GLYPH_MAX_H) ? ILI9341_GLYPH_MAX_H : (uint8_t)info.yDim;
+	memset(glyph->rows, 0x00, sizeof(glyph->rows));
+
+	if( info.show )
+	{
+		for(hd_pixels_t indi = 0; indi < info.numPixels; indi++)
+		{
+			int32_t x = (int32_t)info.xLoc[indi];
+			int32_t y = (int32_t)info.yLoc[indi];
+			if((x < 0) || (x >= glyph->width) || (y < 0) || (y >= glyph->height)){ continue; }
+			glyph->rows[y] |= (uint16_t)(1 << x);
+		}
+	}
+	glyph->valid = true;
+	return info.causesNewline;
+}
+
+const ILI9341_glyph_t* ILI9341::getGlyph( uint8_t code, ILI9341_glyph_t* scratch )
+{
+	if( _glyphCache != NULL )
+	{
+		ILI9341_glyph_t* entry = &_glyphCache->glyphs[code % ILI9341_GLYPH_CACHE_SIZE];
+		if( !(entry->valid && (entry->code == code)) )
+		{
+			expandGlyph(code, entry);
+		}
+		return entry;
+	}
+	expandGlyph(code, scratch);
+	return scratch;
+}
+
+hd_hw_extent_t ILI9341::hwtext( hd_hw_extent_t x0, hd_hw_extent_t y0, const char* str, color_t fg, color_t bg )
+{
+	if((str == NULL) || (fg == NULL) || (bg == NULL)){ return 0; }
+	if((x0 >= xExt) || (y0 >= yExt)){ return 0; }
+
+	uint8_t bpp = getBytesPerPixel( );
+	if( bpp == 0 ){ return 0; }
+
+	// Measure the run first, the line height sets how many rows of each glyph are kept below
+	hd_hw_extent_t width = 0;
+	hd_hw_extent_t height = 0;
+	uint16_t numChars = 0;
+	ILI9341_glyph_t scratch;
+	for(const char* pc = str; (*pc != '\0') && (*pc != '\n'); pc++)
+	{
+		const ILI9341_glyph_t* glyph = getGlyph((uint8_t)*pc, &scratch);
+		if( width + glyph->width > (xExt - x0) ){ break; }
+		width += glyph->width;
+		if( glyph->height > height ){ height = glyph->height; }
+		numChars++;
+	}
+	if( height > (yExt - y0) ){ height = yExt - y0; }
+	if((width == 0) || (height == 0)){ return 0; }
+
+	uint8_t fgPixel[ILI9341_MAX_BPP];
+	uint8_t bgPixel[ILI9341_MAX_BPP];
+	loadPixel(fgPixel, fg);
+	loadPixel(bgPixel, bg);
+
+	// Each glyph is looked up once more and copied (width, then rows as byte pairs) into the front of the scratch arena,
+	// the rest of it is the strip. A line whose glyphs take more than half of the arena goes out as several windows
+	size_t size = 0;
+	uint8_t* glyphs = getScratch(&size);
+	size_t glyphBytes = 1 + ((size_t)height*2);
+	uint16_t chunkChars = (uint16_t)(((size/2)/glyphBytes > numChars) ? numChars : (size/2)/glyphBytes);
+	if( chunkChars == 0 ){ return 0; }
+	uint8_t* stripBuff = glyphs + ((size_t)chunkChars*glyphBytes);
+	size_t stripSize = size - ((size_t)chunkChars*glyphBytes);
+	uint8_t* pend = stripBuff + ((stripSize/bpp)*bpp);
+
+	hd_hw_extent_t x = x0;
+	for(uint16_t first = 0; first < numChars; first += chunkChars)
+	{
+		uint16_t count = ((numChars - first) > chunkChars) ? chunkChars : (numChars - first);
+		hd_hw_extent_t chunkWidth = 0;
+		uint8_t* pglyph = glyphs;
+		for(uint16_t indi = 0; indi < count; indi++)
+		{
+			const ILI9341_glyph_t* glyph = getGlyph((uint8_t)str[first + indi], &scratch);
+			*(pglyph++) = glyph->width;
+			for(hd_hw_extent_t row = 0; row < height; row++)
+			{
+				uint16_t bits = (row < glyph->height) ? glyph->rows[row] : 0x0000;
+				*(pglyph++) = (uint8_t)bits;
+				*(pglyph++) = (uint8_t)(bits >> 8);
+			}
+			chunkWidth += glyph->width;
+		}
+		if( chunkWidth == 0 ){ continue; }
+
+		// Only the part of the chunk inside the clip is sent, the line is still laid out as if it were all there
+		hd_hw_extent_t cx0 = x;
+		hd_hw_extent_t cy0 = y0;
+		hd_hw_extent_t cx1 = x + (chunkWidth - 1);
+		hd_hw_extent_t cy1 = y0 + (height - 1);
+		if( !clipWindow(&cx0, &cy0, &cx1, &cy1) )
+		{
+			x += chunkWidth;
+			continue;
+		}
+		setWindow( cx0, cy0, cx1, cy1 );
+		startRAMWrite( );
+
+		// The window is filled row-major so the strip buffer can be flushed whenever it fills, even part way through a row
+		uint8_t* pdst = stripBuff;
+		for(hd_hw_extent_t row = (cy0 - y0); row <= (hd_hw_extent_t)(cy1 - y0); row++)
+		{
+			pglyph = glyphs;
+			hd_hw_extent_t gx = x;
+			for(uint16_t indi = 0; indi < count; indi++, gx += pglyph[0], pglyph += glyphBytes)
+			{
+				if((gx > cx1) || ((gx + pglyph[0]) <= cx0)){ continue; }
+				uint16_t bits = pglyph[1 + (row*2)] | (pglyph[2 + (row*2)] << 8);
+				uint8_t colStart = (gx < cx0) ? (uint8_t)(cx0 - gx) : 0;
+				uint8_t colEnd = ((gx + pglyph[0]) > (cx1 + 1)) ? (uint8_t)((cx1 + 1) - gx) : pglyph[0];
+				for(uint8_t col = colStart; col < colEnd; col++)
+				{
+					memcpy(pdst, (bits & (1 << col)) ? fgPixel : bgPixel, bpp);
+					pdst += bpp;
+					if( pdst == pend )
+					{
+						continueRAMWrite(stripBuff, (size_t)(pdst - stripBuff));
+						pdst = stripBuff;
+					}
+				}
+			}
+		}
+		if( pdst != stripBuff ){ continueRAMWrite(stripBuff, (size_t)(pdst - stripBuff)); }
+		stopRAMWrite( );
+		x += chunkWidth;
+	}
+	return width;
 }
 
-ILI9341_STAT_t ILI9341::writeToRAM( uint8_t* pdata, uint16_t numBytes )
+hd_hw_extent_t ILI9341::text( hd_extent_t x0, hd_extent_t y0, const char* str, color_t fg, color_t bg )
 {
-	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	if( str == NULL ){ return 0; }
 
-	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
-	retval = writePacket(&cmd, pdata, numBytes);
-	return retval;
+	hd_hw_extent_t x = (hd_hw_extent_t)(pCurrentWindow->xMin + x0);
+	hd_hw_extent_t y = (hd_hw_extent_t)(pCurrentWindow->yMin + y0);
+	hd_hw_extent_t widest = 0;
+	ILI9341_glyph_t scratch;
+	while( true )
+	{
+		hd_hw_extent_t width = hwtext(x, y, str, fg, bg);
+		if( width > widest ){ widest = width; }
+
+		hd_hw_extent_t lineHeight = 0;
+		while((*str != '\0') && (*str != '\n'))
+		{
+			const ILI9341_glyph_t* glyph = getGlyph((uint8_t)*str, &scratch);
+			if( glyph->height > lineHeight ){ lineHeight = glyph->height; }
+			str++;
+		}
+		if( *str == '\0' ){ break; }
+		str++;													// Skip the newline and start the next line underneath
+		y += lineHeight;
+	}
+	return widest;
 }
 
 
@@ -227,10 +1249,71 @@ ILI9341_STAT_t ILI9341::setMemoryAccessControl( bool mx, bool my, bool mv, bool
 	if( ml ){ buff |= 0x10; }
 	if( bgr ){ buff |= 0x08; }
 	if( mh ){ buff |= 0x04; }
+	_madctl = buff;				// Whatever the user sets becomes the orientation that primitives work relative to
 	retval = writePacket(&cmd, &buff, 1);
 	return retval;
 }
 
+ILI9341_STAT_t ILI9341::writeMADCTL( uint8_t madctl )
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+
+	ILI9341_CMD_t cmd = ILI9341_CMD_WRMADCTL;
+	retval = writePacket(&cmd, &madctl, 1);
+	return retval;
+}
+
+uint8_t ILI9341::getMADCTLFor( bool mirrorX, bool mirrorY, bool swapXY )
+{
+	// MV exchanges rows and columns before MX and MY mirror the panel's own columns and rows, 
+	// so once exchanged mirroring x means flipping MY and mirroring y means flipping MX
+	uint8_t madctl = _madctl;
+	bool exchanged = (madctl & ILI9341_MADCTL_MV);
+	if( mirrorX ){ madctl ^= (exchanged) ? ILI9341_MADCTL_MY : ILI9341_MADCTL_MX; }
+	if( mirrorY ){ madctl ^= (exchanged) ? ILI9341_MADCTL_MX : ILI9341_MADCTL_MY; }
+	if( swapXY ){ madctl ^= ILI9341_MADCTL_MV; }	// Swapping alone keeps every pixel where it was, only the fill order changes
+	return madctl;
+}
+
+ILI9341_STAT_t ILI9341::setRotation( uint16_t degrees )
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+
+	uint8_t madctl = (_madctl & (ILI9341_MADCTL_ML | ILI9341_MADCTL_BGR | ILI9341_MADCTL_MH));
+	switch( degrees )
+	{
+		case 0 : 	madctl |= ILI9341_MADCTL_MY; break;
+		case 90 : 	madctl |= (ILI9341_MADCTL_MX | ILI9341_MADCTL_MY | ILI9341_MADCTL_MV); break;
+		case 180 : 	madctl |= ILI9341_MADCTL_MX; break;
+		case 270 : 	madctl |= ILI9341_MADCTL_MV; break;
+		default : 	return ILI9341_STAT_Error;
+	}
+
+	retval = writeMADCTL( madctl );
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	_madctl = madctl;
+
+	if( ((degrees / 90) & 0x01) != ((_rotation / 90) & 0x01) )
+	{
+		// Keep the default full-screen window covering the whole screen
+		if( (pCurrentWindow != NULL) && (pCurrentWindow->xMin == 0) && (pCurrentWindow->yMin == 0) && (pCurrentWindow->xMax == (xExt - 1)) && (pCurrentWindow->yMax == (yExt - 1)) )
+		{
+			pCurrentWindow->xMax = yExt - 1;
+			pCurrentWindow->yMax = xExt - 1;
+		}
+		uint16_t temp = xExt;
+		xExt = yExt;
+		yExt = temp;
+	}
+	_rotation = degrees;
+	return retval;
+}
+
+uint16_t ILI9341::getRotation( void )
+{
+	return _rotation;
+}
+
 ILI9341_STAT_t ILI9341::selectGammaCurve( uint8_t bmNumber )
 {
 	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
@@ -508,6 +1591,20 @@ ILI9341_4WSPI::ILI9341_4WSPI(uint16_t xSize, uint16_t ySize) : hyperdisplay( xSi
 {
 	SPISettings tempSettings(ILI9341_SPI_MAX_FREQ, ILI9341_SPI_DATA_ORDER, ILI9341_SPI_MODE);
 	_spisettings = tempSettings;
+	_spiFreq = ILI9341_SPI_MAX_FREQ;
+	SPISettings tempReadSettings(ILI9341_SPI_READ_FREQ, ILI9341_SPI_DATA_ORDER, ILI9341_SPI_MODE);
+	_readsettings = tempReadSettings;
+	_spiReadFreq = ILI9341_SPI_READ_FREQ;
+	memset(&_cal, 0x00, sizeof(_cal));
+	_batch = false;
+	_scheduler = NULL;
+	_schedulerClient = 0;
+	_sliceBytesLeft = 0;
+	_yielded = false;
+	_yieldScratch.buff = _yieldBuff;
+	_yieldScratch.size = sizeof(_yieldBuff);
+	_yieldScratch.colorBpp = 0;
+	_yieldScratch.colorPixels = 0;
 }
 
 ////////////////////////////////////////////////////////////
@@ -515,8 +1612,13 @@ ILI9341_4WSPI::ILI9341_4WSPI(uint16_t xSize, uint16_t ySize) : hyperdisplay( xSi
 ////////////////////////////////////////////////////////////
 ILI9341_STAT_t ILI9341_4WSPI::writePacket(ILI9341_CMD_t* pcmd, uint8_t* pdata, uint16_t dlen)
 {
-	selectDriver();
-	_spi->beginTransaction(_spisettings);
+	if( _yielded ){ return ILI9341_STAT_Error; }
+	if( !_batch )
+	{
+		if( _scheduler != NULL ){ _scheduler->beginHold(); }
+		selectDriver();
+		_spi->beginTransaction(_spisettings);
+	}
 
 	if(pcmd != NULL)
 	{
@@ -531,8 +1633,151 @@ ILI9341_STAT_t ILI9341_4WSPI::writePacket(ILI9341_CMD_t* pcmd, uint8_t* pdata, u
 		transferSPIbuffer(pdata, dlen, ARDUINO_STILL_BROKEN );
 	}		
 
+	if( _batch ){ return ILI9341_STAT_Nominal; }
+	_spi->endTransaction();	
+	deselectDriver();
+	if( _scheduler != NULL ){ _scheduler->endHold(); }
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::readPacket(ILI9341_CMD_t* pcmd, uint8_t* pdata, uint16_t dlen, uint8_t dummyBytes)
+{
+	if( _batch || _yielded ){ return ILI9341_STAT_Error; }		// Reads need their own clock
+	if( _scheduler != NULL ){ _scheduler->beginHold(); }
+	selectDriver();
+	_spi->beginTransaction(_readsettings);
+
+	if(pcmd != NULL)
+	{
+		digitalWrite(_dc, LOW);
+		_spi->transfer(*(pcmd));
+	}
+
+	digitalWrite(_dc, HIGH);
+	for(uint8_t indi = 0; indi < dummyBytes; indi++)
+	{
+		_spi->transfer((uint8_t)0x00);
+	}
+	if( pdata != NULL )
+	{
+		for(uint16_t indi = 0; indi < dlen; indi++)
+		{
+			pdata[indi] = _spi->transfer((uint8_t)0x00);
+		}
+	}
+
+	_spi->endTransaction();
+	deselectDriver();
+	if( _scheduler != NULL ){ _scheduler->endHold(); }
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::startRAMWrite( void )
+{
+	if( _yielded ){ return ILI9341_STAT_Error; }
+	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
+	writePacket(&cmd);					// Send the command to enable writing to RAM but don't send any data yet
+
+	// Keep the bus until stopRAMWrite so that each chunk of data costs nothing more than the transfer itself
+	if( _scheduler != NULL )
+	{ 
+		if( !_batch ){ _scheduler->beginHold(); }
+		_sliceBytesLeft = _scheduler->getSliceBytes(_spiFreq);
+	}
+	if( _batch )
+	{
+		digitalWrite(_dc, HIGH);		// Already selected and in a transaction
+		return ILI9341_STAT_Nominal;
+	}
+	selectDriver();
+	digitalWrite(_dc, HIGH);
+	_spi->beginTransaction(_spisettings);
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::continueRAMWrite( uint8_t* pdata, size_t numBytes )
+{
+	if( _yielded ){ return ILI9341_STAT_Error; }
+	if((_scheduler == NULL) || (_scratch == &ILI9341_defaultScratch)){ return transferSPIbuffer(pdata, numBytes, ARDUINO_STILL_BROKEN ); }	// Other displays could overwrite a shared arena while this one waits
+
+	while( numBytes )
+	{
+		if( _sliceBytesLeft == 0 ){ yieldBus(); }
+		size_t chunk = (numBytes > _sliceBytesLeft) ? _sliceBytesLeft : numBytes;
+		transferSPIbuffer(pdata, chunk, ARDUINO_STILL_BROKEN );
+		pdata += chunk;
+		numBytes -= chunk;
+		_sliceBytesLeft -= chunk;
+	}
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::stopRAMWrite( void )
+{
+	if( _yielded ){ return ILI9341_STAT_Error; }
+	if( _batch ){ return ILI9341_STAT_Nominal; }		// stopBatch lets go of the bus
+	_spi->endTransaction();	
+	deselectDriver();
+	if( _scheduler != NULL ){ _scheduler->endHold(); }
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::startBatch( void )
+{
+	if( _batch || _yielded ){ return ILI9341_STAT_Error; }
+	if( _scheduler != NULL ){ _scheduler->beginHold(); }
+	selectDriver();
+	_spi->beginTransaction(_spisettings);
+	_batch = true;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::stopBatch( void )
+{
+	if( !_batch || _yielded ){ return ILI9341_STAT_Error; }
+	_batch = false;
+	_spi->endTransaction();
+	deselectDriver();
+	if( _scheduler != NULL ){ _scheduler->endHold(); }
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_4WSPI::yieldBus( void )
+{
 	_spi->endTransaction();	
 	deselectDriver();
+	_scheduler->endHold();
+
+	// Jobs that draw on this display now fail and get a one pixel arena of their own, so the window and
+	// the data still to be sent are exactly as they were and write memory continue picks up where it stopped
+	ILI9341_scratch_t* scratch = _scratch;
+	_yieldScratch.colorBpp = 0;
+	_scratch = &_yieldScratch;
+	_yielded = true;
+	_scheduler->yield(_schedulerClient);
+	_yielded = false;
+	_scratch = scratch;
+
+	_scheduler->beginHold();
+	selectDriver();
+	_spi->beginTransaction(_spisettings);
+	digitalWrite(_dc, LOW);
+	_spi->transfer((uint8_t)ILI9341_CMD_WRRAMCONT);
+	digitalWrite(_dc, HIGH);
+	_sliceBytesLeft = _scheduler->getSliceBytes(_spiFreq);
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::setBusScheduler( ILI9341_BusScheduler* scheduler )
+{
+	if( _yielded ){ return ILI9341_STAT_Error; }
+	if( scheduler != NULL )
+	{
+		if( _scratch == &ILI9341_defaultScratch ){ return ILI9341_STAT_Error; }		// Needs its own arena, see setScratchBuffer
+		int8_t client = scheduler->addClient();
+		if( client < 0 ){ return ILI9341_STAT_Error; }
+		_schedulerClient = (uint8_t)client;
+	}
+	_scheduler = scheduler;
 	return ILI9341_STAT_Nominal;
 }
 
@@ -565,22 +1810,178 @@ ILI9341_STAT_t ILI9341_4WSPI::setSPIFreq( uint32_t freq )
 {
 	SPISettings tempSettings(freq, ILI9341_SPI_DATA_ORDER, ILI9341_SPI_MODE);
 	_spisettings = tempSettings;
+	_spiFreq = freq;
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_4WSPI::retuneSPI( void )
+{
+	// The settings are only read when a transaction starts
+	_spi->endTransaction();
+	_spi->beginTransaction(_spisettings);
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::setSPIReadFreq( uint32_t freq )
+{
+	SPISettings tempSettings(freq, ILI9341_SPI_DATA_ORDER, ILI9341_SPI_MODE);
+	_readsettings = tempSettings;
+	_spiReadFreq = freq;
+	return ILI9341_STAT_Nominal;
+}
+
+uint32_t ILI9341_4WSPI::getSPIFreq( void )
+{
+	return _spiFreq;
+}
+
+uint32_t ILI9341_4WSPI::getSPIReadFreq( void )
+{
+	return _spiReadFreq;
+}
+
+uint16_t ILI9341_4WSPI::checkPattern( hd_hw_extent_t x0, hd_hw_extent_t y0, uint8_t seed, uint32_t cmdFreq, uint32_t writeFreq, uint32_t readFreq )
+{
+	uint8_t bpp = getBytesPerPixel();
+	if((bpp == 0) || (x0 >= xExt) || (y0 >= yExt) || _batch){ return 0xFFFF; }	// Reads can't happen inside a batch
+
+	// Room for the pattern and its read back, which is always three bytes per pixel
+	size_t size = 0;
+	uint8_t* pattern = getScratch(&size);
+	hd_pixels_t numPixels = size/(bpp + 3);
+	if( numPixels > ILI9341_SPI_CAL_PIXELS ){ numPixels = ILI9341_SPI_CAL_PIXELS; }
+	if( numPixels > (hd_pixels_t)(xExt - x0) ){ numPixels = xExt - x0; }
+	if( numPixels == 0 ){ return 0xFFFF; }
+	uint8_t* readback = pattern + ((size_t)numPixels*bpp);
+
+	// Every line toggling on every bit, then alternating bits, then pseudo random data
+	uint8_t lfsr = seed | 0x01;
+	for(size_t indi = 0; indi < (size_t)numPixels*bpp; indi++)
+	{
+		if( seed == 0 ){ pattern[indi] = (indi & 0x01) ? 0x00 : 0xFF; }
+		else if( seed == 1 ){ pattern[indi] = (indi & 0x01) ? 0x55 : 0xAA; }
+		else
+		{
+			lfsr = (lfsr << 1) ^ ((lfsr & 0x80) ? 0x1D : 0x00);
+			pattern[indi] = lfsr;
+		}
+	}
+
+	// Commands (here and in the read back) always go at cmdFreq so that only the pixel data is tested at the new clock
+	setSPIFreq(cmdFreq);
+	setWindow(x0, y0, x0 + (numPixels - 1), y0);
+	startRAMWrite();
+	setSPIFreq(writeFreq);
+	retuneSPI();
+	continueRAMWrite(pattern, (size_t)numPixels*bpp);
+	stopRAMWrite();
+	setSPIFreq(cmdFreq);
+
+	setSPIReadFreq(readFreq);
+	if( readRAM(x0, y0, x0 + (numPixels - 1), y0, readback, numPixels) != ILI9341_STAT_Nominal ){ return 0xFFFF; }
+
+	// Only the bits the panel actually stores can be compared
+	uint16_t errors = 0;
+	for(hd_pixels_t indi = 0; indi < numPixels; indi++)
+	{
+		const uint8_t* pp = pattern + ((size_t)indi*bpp);
+		const uint8_t* pr = readback + ((size_t)indi*3);
+		uint8_t expect[3];
+		uint8_t mask[3] = {0xFC, 0xFC, 0xFC};
+		if( bpp == 2 )
+		{
+			expect[0] = pp[0] & 0xF8;
+			expect[1] = ((pp[0] & 0x07) << 5) | ((pp[1] & 0xE0) >> 3);
+			expect[2] = (pp[1] & 0x1F) << 3;
+			mask[0] = 0xF8;
+			mask[2] = 0xF8;
+		}
+		else
+		{
+			expect[0] = pp[0];
+			expect[1] = pp[1];
+			expect[2] = pp[2];
+		}
+		for(uint8_t chan = 0; chan < 3; chan++)
+		{
+			if( (pr[chan] ^ expect[chan]) & mask[chan] ){ errors++; }
+		}
+	}
+	return errors;
+}
+
+ILI9341_STAT_t ILI9341_4WSPI::calibrateSPI( hd_hw_extent_t x0, hd_hw_extent_t y0, uint32_t minFreq, uint32_t maxFreq, uint32_t step, uint8_t marginPercent )
+{
+	if((minFreq == 0) || (step == 0) || (maxFreq < minFreq) || (marginPercent >= 100)){ return ILI9341_STAT_Error; }
+	if( getBytesPerPixel() == 0 ){ return ILI9341_STAT_Error; }
+
+	uint32_t oldFreq = _spiFreq;
+	uint32_t oldReadFreq = _spiReadFreq;
+	memset(&_cal, 0x00, sizeof(_cal));
+
+	// Reads give out long before writes, so find their limit first with the writes held at the slowest clock
+	for(uint32_t freq = minFreq; ; freq += step)
+	{
+		uint32_t errors = 0;
+		for(uint8_t seed = 0; seed < 3; seed++){ errors += checkPattern(x0, y0, seed, minFreq, minFreq, freq); }
+		if( errors != 0 ){ _cal.readErrors = (errors > 0xFFFF) ? 0xFFFF : (uint16_t)errors; break; }
+		_cal.maxReadFreq = freq;
+		if( (maxFreq - freq) < step ){ _cal.readLimited = true; break; }
+	}
+	if( _cal.maxReadFreq == 0 )
+	{
+		setSPIFreq(oldFreq);
+		setSPIReadFreq(oldReadFreq);
+		return ILI9341_STAT_Error;
+	}
+	_cal.readFreq = (uint32_t)(((uint64_t)_cal.maxReadFreq*(100 - marginPercent))/100);
+	if( _cal.readFreq < minFreq ){ _cal.readFreq = minFreq; }
+
+	// Then check writes against reads at a clock that is known to be good
+	for(uint32_t freq = minFreq; ; freq += step)
+	{
+		uint32_t errors = 0;
+		for(uint8_t seed = 0; seed < 3; seed++){ errors += checkPattern(x0, y0, seed, minFreq, freq, _cal.readFreq); }
+		if( errors != 0 ){ _cal.writeErrors = (errors > 0xFFFF) ? 0xFFFF : (uint16_t)errors; break; }
+		_cal.maxWriteFreq = freq;
+		if( (maxFreq - freq) < step ){ _cal.writeLimited = true; break; }
+	}
+	if( _cal.maxWriteFreq == 0 )
+	{
+		setSPIFreq(oldFreq);
+		setSPIReadFreq(oldReadFreq);
+		return ILI9341_STAT_Error;
+	}
+	_cal.writeFreq = (uint32_t)(((uint64_t)_cal.maxWriteFreq*(100 - marginPercent))/100);
+	if( _cal.writeFreq < minFreq ){ _cal.writeFreq = minFreq; }
+
+	setSPIFreq(_cal.writeFreq);
+	setSPIReadFreq(_cal.readFreq);
 	return ILI9341_STAT_Nominal;
 }
 
+const ILI9341_spi_cal_t* ILI9341_4WSPI::getCalibration( void )
+{
+	return &_cal;
+}
+
 void    ILI9341_4WSPI::hwxline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t len, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool goLeft)
 {
 	if(data == NULL){ return; }
 	if( len < 1 ){ return; }
 
-	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 0);	// This line is needed to condition the user's input start color offset
-
-	color_t value = getOffsetColor(data, startColorOffset);
-	uint8_t bpp = getBytesPerPixel( );
+	// Clip in screen coordinates - the first pixel drawn is x0 either way, so trimming it skips ahead in the cycle
+	hd_hw_extent_t xa = goLeft ? ((x0 >= (len - 1)) ? (x0 - (len - 1)) : 0) : x0;
+	hd_hw_extent_t xb = goLeft ? x0 : (x0 + (len - 1));
+	hd_hw_extent_t y1 = y0;
+	if( !clipWindow(&xa, &y0, &xb, &y1) ){ return; }
+	hd_hw_extent_t skip = goLeft ? (x0 - xb) : (xa - x0);
+	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, skip);
+	x0 = goLeft ? xb : xa;
+	len = (xb - xa) + 1;
 
 	if( goLeft )
 	{ 
-		setMemoryAccessControl( true, true, false, false, true, false ); 
+		writeMADCTL( getMADCTLFor( true, false, false ) ); 
 		x0 = (xExt - 1) - x0;
 	}
 	hd_hw_extent_t x1 = x0 + (len - 1);
@@ -589,56 +1990,12 @@ void    ILI9341_4WSPI::hwxline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_exten
 	setColumnAddress( x0, x1);
 	setRowAddress(y0, y0);
 
-	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
-	writePacket(&cmd);					// Send the command to enable writing to RAM but don't send any data yet
-
 	// Now, we need to send data with as little overhead as possible, while respecting the start offset and color cycle length and everything else...
-	selectDriver();
-	digitalWrite(_dc, HIGH);
-	_spi->beginTransaction(_spisettings);
-
-	if(colorCycleLength == 1)
-	{
-		// Special case that can be handled with a lot less thinking (so faster)
-		uint8_t speedupArry[ILI9341_MAX_X*ILI9341_MAX_BPP];
-		for(uint16_t indi = 0; indi < len; indi++)
-		{
-			for(uint8_t indj = 0; indj < bpp; indj++)
-			{
-				speedupArry[ indj + (indi*bpp) ] = *((uint8_t*)(data) + indj);
-			}
-		}
-		// _spi->transfer(speedupArry, len*bpp);
-		transferSPIbuffer(speedupArry, len*bpp, ARDUINO_STILL_BROKEN );
-	}
-	else
-	{
-		uint16_t pixelsToDraw = 0;
-		uint16_t pixelsDrawn = 0;
-
-		while(len != 0)
-		{
-			// Let's figure out how many pixels we can draw right now contiguously.. (thats from the start offset to the full legnth of the cycle)
-			uint16_t pixelsAvailable = colorCycleLength - startColorOffset;
-			value = getOffsetColor(data, startColorOffset);
-			
-			if( pixelsAvailable >= len ){ pixelsToDraw = len; }
-			else if( pixelsAvailable < len ){ pixelsToDraw = pixelsAvailable; }
-
-			// // Draw "pixelsToDraw" pixels using "bpp*pixelsToDraw" bytes
-			// _spi->transfer(value, bpp*pixelsToDraw);
-			transferSPIbuffer((uint8_t*)value, bpp*pixelsToDraw, ARDUINO_STILL_BROKEN );
-
-			len -= pixelsToDraw;
-			pixelsDrawn = pixelsToDraw;
-			startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, pixelsDrawn);
-		}
-	}
-
-	_spi->endTransaction();	
-	deselectDriver();
+	startRAMWrite();
+	streamColorCycle(data, len, colorCycleLength, startColorOffset);
+	stopRAMWrite();
 
-	if( goLeft ){ setMemoryAccessControl( false, true, false, false, true, false ); } // Reset to defaults
+	if( goLeft ){ writeMADCTL( _madctl ); } // Reset to the current orientation
 }
 
 
@@ -648,14 +2005,18 @@ void    ILI9341_4WSPI::hwyline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_exten
 	if(data == NULL){ return; } 
 	if( len < 1 ){ return; }
 
-	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, 0);	// This line is needed to condition the user's input start color offset
-	color_t value = getOffsetColor(data, startColorOffset);
-	uint8_t bpp = getBytesPerPixel( );
+	hd_hw_extent_t ya = goUp ? ((y0 >= (len - 1)) ? (y0 - (len - 1)) : 0) : y0;
+	hd_hw_extent_t yb = goUp ? y0 : (y0 + (len - 1));
+	hd_hw_extent_t x1 = x0;
+	if( !clipWindow(&x0, &ya, &x1, &yb) ){ return; }
+	hd_hw_extent_t skip = goUp ? (y0 - yb) : (ya - y0);
+	startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, skip);
+	y0 = goUp ? yb : ya;
+	len = (yb - ya) + 1;
 
 	if( goUp )
 	{ 
-		//setMemoryAccessControl( false, true, false, false, true, false );
-		setMemoryAccessControl( false, false, false, false, true, false ); 
+		writeMADCTL( getMADCTLFor( false, true, false ) ); 
 		y0 = (yExt - 1) - y0; 
 	}
 	hd_hw_extent_t y1 = y0 + (len - 1);
@@ -664,102 +2025,93 @@ void    ILI9341_4WSPI::hwyline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_exten
 	setColumnAddress( x0, x0);
 	setRowAddress(y0, y1);
 
-	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
-	writePacket(&cmd);					// Send the command to enable writing to RAM but don't send any data yet
-
 	// Now, we need to send data with as little overhead as possible, while respecting the start offset and color cycle length and everything else...
-	selectDriver();
-	digitalWrite(_dc, HIGH);
-	_spi->beginTransaction(_spisettings);
+	startRAMWrite();
+	streamColorCycle(data, len, colorCycleLength, startColorOffset);
+	stopRAMWrite();
+
+	if( goUp )
+	{ 
+		writeMADCTL( _madctl );
+	}
+}
+
+void 	ILI9341_4WSPI::hwrectangle(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, bool filled, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool reverseGradient, bool gradientVertical)
+{
+	if(data == NULL){ return; }
 
+	hd_hw_extent_t xa = (x0 < x1) ? x0 : x1;
+	hd_hw_extent_t ya = (y0 < y1) ? y0 : y1;
+	hd_hw_extent_t xb = (x0 < x1) ? x1 : x0;
+	hd_hw_extent_t yb = (y0 < y1) ? y1 : y0;
+	if( !clipWindow(&xa, &ya, &xb, &yb) ){ return; }	// Nothing visible, don't even split it into lines
 
-	if(colorCycleLength == 1)
+	// Outlines and gradients are left to HyperDisplay, which builds them from our hwxline and hwyline (and so still gets the expansion buffer, and the clip)
+	if( !filled || (colorCycleLength != 1) )
 	{
-		// Special case that can be handled with a lot less thinking (so faster)
-		uint8_t speedupArry[ILI9341_MAX_Y*ILI9341_MAX_BPP];
-		for(uint16_t indi = 0; indi < len; indi++)
-		{
-			for(uint8_t indj = 0; indj < bpp; indj++)
-			{
-				speedupArry[ indj + (indi*bpp) ] = *((uint8_t*)(data) + indj);
-			}
-		}
-		// _spi->transfer(speedupArry, len*bpp);
-		transferSPIbuffer(speedupArry, len*bpp, ARDUINO_STILL_BROKEN );
+		hyperdisplay::hwrectangle(x0, y0, x1, y1, filled, data, colorCycleLength, startColorOffset, reverseGradient, gradientVertical);
+		return;
 	}
-	else
-	{
-		uint16_t pixelsToDraw = 0;
-		uint16_t pixelsDrawn = 0;
 
-		while(len != 0)
-		{
-			// Let's figure out how many pixels we can draw right now contiguously.. (thats from the start offset to the full legnth of the cycle)
-			uint16_t pixelsAvailable = colorCycleLength - startColorOffset;
-			value = getOffsetColor(data, startColorOffset);
-			
-			if( pixelsAvailable >= len ){ pixelsToDraw = len; }
-			else if( pixelsAvailable < len ){ pixelsToDraw = pixelsAvailable; }
-
-			// // Draw "pixelsToDraw" pixels using "bpp*pixelsToDraw" bytes
-			// _spi->transfer(value, bpp*pixelsToDraw);
-			transferSPIbuffer((uint8_t*)value, bpp*pixelsToDraw, ARDUINO_STILL_BROKEN );
-
-			len -= pixelsToDraw;
-			pixelsDrawn = pixelsToDraw;
-			startColorOffset = getNewColorOffset(colorCycleLength, startColorOffset, pixelsDrawn);
-		}
-	}
+	x0 = xa;
+	y0 = ya;
+	x1 = xb;
+	y1 = yb;
 
-	_spi->endTransaction();	
-	deselectDriver();
+	// A solid fill is the same no matter the gradient direction, so the whole rectangle goes out as one window
+	setColumnAddress( x0, x1);
+	setRowAddress(y0, y1);
 
-	if( goUp )
-	{ 
-		setMemoryAccessControl( false, true, false, false, true, false );
-	}
+	startRAMWrite();
+	streamColorCycle(data, (hd_pixels_t)(x1 - x0 + 1)*(y1 - y0 + 1));
+	stopRAMWrite();
 }
 
-// void 	ILI9341_4WSPI::hwrectangle(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, bool filled, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool reverseGradient, bool gradientVertical)
-// {
-// // Hardware rectangle is left unimplemented because it's hard to squeeze out much more performance than the built-in function that uses our more efficient versions of hwxline and hwyline	
-// }
-
 void ILI9341_4WSPI::hwfillFromArray(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data, hd_pixels_t numPixels, bool Vh)
 {
 	if(numPixels == 0){ return; }
 	if(data == NULL ){ return; }
 
-	uint8_t bpp = getBytesPerPixel();
-
-	if( Vh )
-	{ 
-		setMemoryAccessControl( true, true, true, false, true, false );
-
-		setColumnAddress( y0, y1);
-		setRowAddress(x0, x1);
+	hd_hw_extent_t xa = x0, ya = y0, xb = x1, yb = y1;
+	if( !clipWindow(&xa, &ya, &xb, &yb) ){ return; }
+
+	// The array runs along the fast axis of the window - x normally, y when Vh swaps them
+	hd_hw_extent_t f0 = Vh ? y0 : x0;
+	hd_hw_extent_t fa = Vh ? ya : xa;
+	hd_hw_extent_t fb = Vh ? yb : xb;
+	hd_hw_extent_t s0 = Vh ? x0 : y0;
+	hd_hw_extent_t sa = Vh ? xa : ya;
+	hd_hw_extent_t sb = Vh ? xb : yb;
+	hd_pixels_t stride = (Vh ? (y1 - y0) : (x1 - x0)) + 1;
+	if( (hd_pixels_t)(sa - s0)*stride + (fa - f0) >= numPixels ){ return; }	// The visible part is past the end of the data
+
+	if( Vh ){ writeMADCTL( getMADCTLFor( false, false, true ) ); }
+	setColumnAddress( fa, fb);
+	setRowAddress(sa, sb);
+
+	startRAMWrite();
+	if( (hd_pixels_t)((fb - fa) + 1) == stride )
+	{
+		// Whole lines are contiguous in the source, so only the start moves
+		hd_pixels_t offset = (hd_pixels_t)(sa - s0)*stride;
+		hd_pixels_t count = (hd_pixels_t)((sb - sa) + 1)*stride;
+		if( count > (numPixels - offset) ){ count = numPixels - offset; }
+		continuePixelWrite((const uint8_t*)getOffsetColor(data, offset), count);	// With a scheduler attached this is where the blit gets sliced
 	}
 	else
 	{
-		setColumnAddress( x0, x1);
-		setRowAddress(y0, y1);
+		for(hd_hw_extent_t line = sa; line <= sb; line++)
+		{
+			hd_pixels_t offset = ((hd_pixels_t)(line - s0)*stride) + (fa - f0);
+			if( offset >= numPixels ){ break; }
+			hd_pixels_t count = (fb - fa) + 1;
+			if( count > (numPixels - offset) ){ count = numPixels - offset; }
+			continuePixelWrite((const uint8_t*)getOffsetColor(data, offset), count);
+		}
 	}
-	
-
-	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
-	writePacket(&cmd);					// Send the command to enable writing to RAM but don't send any data yet
-
-	selectDriver();
-	digitalWrite(_dc, HIGH);
-	_spi->beginTransaction(_spisettings);
-
-	// _spi->transfer((uint8_t*)data, bpp*numPixels);
-	transferSPIbuffer((uint8_t*)data, bpp*numPixels, ARDUINO_STILL_BROKEN );
-
-	_spi->endTransaction();	
-	deselectDriver();
+	stopRAMWrite();
 
-	if( Vh ){ setMemoryAccessControl( true, true, false, false, true, false ); }
+	if( Vh ){ writeMADCTL( _madctl ); }
 }
 
 
@@ -29,6 +29,28 @@ Authors: Alex Wende
 #define ILI9341_STOP_ROW 319
 #define ILI9341_MAX_BPP 4
 
+#define ILI9341_MADCTL_MY 0x80
+#define ILI9341_MADCTL_MX 0x40
+#define ILI9341_MADCTL_MV 0x20
+#define ILI9341_MADCTL_ML 0x10
+#define ILI9341_MADCTL_BGR 0x08
+#define ILI9341_MADCTL_MH 0x04
+#define ILI9341_MADCTL_DEFAULT (ILI9341_MADCTL_MY | ILI9341_MADCTL_BGR)	// Portrait, rotation 0
+
+#ifndef ILI9341_SCRATCH_BYTES
+#define ILI9341_SCRATCH_BYTES (ILI9341_MAX_X*ILI9341_MAX_BPP)	// Size of the default scratch arena shared by all displays that don't supply their own
+#endif
+#ifndef ILI9341_SCRATCH_ATTR
+#define ILI9341_SCRATCH_ATTR 									// Placement of the default arena, e.g. define as DMA_ATTR on ESP32
+#endif
+
+#define ILI9341_GLYPH_MAX_W 16			// Glyphs are expanded into one uint16_t per row, so they can be no wider than this
+#define ILI9341_GLYPH_MAX_H 16
+#define ILI9341_GLYPH_CACHE_SIZE 16		// Direct-mapped on code % 16, so '0'-'9' are distinct from each other but not from everything else
+
+#ifndef ILI9341_CLIP_DEPTH
+#define ILI9341_CLIP_DEPTH 4			// How many clip rectangles can be nested
+#endif
 
 
 
@@ -69,7 +91,7 @@ typedef enum{
 	ILI9341_CMD_RASET,
 	ILI9341_CMD_WRRAM,
 	ILI9341_CMD_WRCS,
-	// ILI9341_CMD_RDRAM // Not implemented.....?
+	ILI9341_CMD_RDRAM,
 	ILI9341_CMD_PTLAREA = 0x30,
 	//
 	ILI9341_CMD_WRVSCRL = 0x33,
@@ -81,6 +103,10 @@ typedef enum{
 	ILI9341_CMD_IDLON,
 	ILI9341_CMD_WRPXFMT,
 	//
+	ILI9341_CMD_WRRAMCONT = 0x3C,
+	//
+	ILI9341_CMD_RDRAMCONT = 0x3E,
+	//
 	ILI9341_CMD_WRNMLFRCTL = 0xB1,
 	ILI9341_CMD_WRIDLFRCTL,
 	ILI9341_CMD_WRPTLFRCTL,
@@ -142,6 +168,33 @@ typedef struct ILI9341_color_12{
 	uint8_t b1;	// Green low, blue
 }ILI9341_color_12_t;
 
+typedef struct ILI9341_scratch{
+	uint8_t* buff;
+	size_t size;
+	uint8_t color[ILI9341_MAX_BPP];	// Last color replicated through the buffer
+	uint8_t colorBpp;				// Zero whenever the buffer holds anything other than a replicated color
+	hd_pixels_t colorPixels;		// Number of copies of the color already in place
+}ILI9341_scratch_t;
+
+typedef struct ILI9341_glyph{
+	uint8_t code;						// Character this glyph was expanded from
+	uint8_t width;						// Horizontal advance of the glyph in pixels (xDim from getCharInfo)
+	uint8_t height;						// Vertical size of the glyph in pixels (yDim from getCharInfo)
+	bool valid;
+	uint16_t rows[ILI9341_GLYPH_MAX_H];	// Bit n of rows[r] is set when the pixel at column n of row r is part of the glyph
+}ILI9341_glyph_t;
+
+typedef struct ILI9341_clip{
+	hd_hw_extent_t x0;		// Inclusive hardware coordinates, x0 > x1 when nothing is visible
+	hd_hw_extent_t y0;
+	hd_hw_extent_t x1;
+	hd_hw_extent_t y1;
+}ILI9341_clip_t;
+
+typedef struct ILI9341_glyph_cache{
+	ILI9341_glyph_t glyphs[ILI9341_GLYPH_CACHE_SIZE];	// Pre-expanded bitmaps for one font, clear it when the font changes. Codes 16 apart share a slot and evict each other
+}ILI9341_glyph_cache_t;
+
 
 ////////////////////////////////////////////////////////////
 //					 Class Definition   				  //
@@ -153,10 +206,31 @@ protected:
 
 	ILI9341_INTFC_t _intfc;
 	ILI9341_PXLFMT_t _pxlfmt;
+	ILI9341_glyph_cache_t* _glyphCache;
+	ILI9341_scratch_t* _scratch;
+	ILI9341_scratch_t _userScratch;
+	uint8_t _madctl;			// MADCTL for the current orientation, primitives derive temporary settings from it
+	uint16_t _rotation;
+	bool _nativeEndian;			// 565 colors handed in by the application are native uint16_t rather than wire order
+	ILI9341_clip_t _clipStack[ILI9341_CLIP_DEPTH];	// Each entry is already intersected with the ones below it
+	uint8_t _clipDepth;
+	wind_info_t* _dirtyWindow;	// Buffered window whose rows _dirtyRows tracks, any other window is sent whole
+	uint8_t _dirtyRows[(ILI9341_MAX_Y + 7)/8];
+
+	bool clipWindow( hd_hw_extent_t* x0, hd_hw_extent_t* y0, hd_hw_extent_t* x1, hd_hw_extent_t* y1 );	// False when the window is fully clipped
+
+	uint8_t getMADCTLFor( bool mirrorX, bool mirrorY, bool swapXY );
+	ILI9341_STAT_t writeMADCTL( uint8_t madctl );
+
+	bool expandGlyph( uint8_t code, ILI9341_glyph_t* glyph );
 
 	// Pure virtual functions from HyperDisplay Implemented:
 	color_t getOffsetColor(color_t base, uint32_t numPixels);
 	void 	hwpixel(hd_hw_extent_t x0, hd_hw_extent_t y0, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0);
+	using hyperdisplay::hwxline;			// Made public so that compositors can drive panels through this class
+	using hyperdisplay::hwyline;
+	using hyperdisplay::hwrectangle;
+	using hyperdisplay::hwfillFromArray;
     // // Note: only the hwpixel function is implemented at this level because it can be optimized using the writePacket API. Further optimizations are made in further derived classes like 4WSPI (below)
     // virtual void    hwxline(uint16_t x0, uint16_t y0, uint16_t len, color_t data = NULL, uint16_t colorCycleLength = 1, uint16_t startColorOffset = 0, bool goLeft = false);
     // virtual void    hwyline(uint16_t x0, uint16_t y0, uint16_t len, color_t data = NULL, uint16_t colorCycleLength = 1, uint16_t startColorOffset = 0, bool goUp = false);
@@ -164,6 +238,11 @@ protected:
     // virtual void 	hwfillFromArray(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint32_t numPixels, color_t data);
 
 	void swpixel( hd_extent_t x0, hd_extent_t y0, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0);
+	void swxline( hd_extent_t x0, hd_extent_t y0, hd_extent_t len, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool goLeft = false);
+	void swyline( hd_extent_t x0, hd_extent_t y0, hd_extent_t len, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool goUp = false);
+	void swrectangle( hd_extent_t x0, hd_extent_t y0, hd_extent_t x1, hd_extent_t y1, bool filled = false, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool reverseGradient = false, bool gradientVertical = false);
+	void swfillFromArray( hd_extent_t x0, hd_extent_t y0, hd_extent_t x1, hd_extent_t y1, color_t data = NULL, hd_pixels_t numPixels = 0, bool Vh = false);
+	void markDirtyRows( hd_hw_extent_t y0, hd_hw_extent_t y1 );	// Window rows of pCurrentWindow that showWindow has to send
 
 public:
 
@@ -173,17 +252,37 @@ public:
 	static ILI9341_color_16_t hsvTo16b( uint16_t h, uint8_t s, uint8_t v );
 	static ILI9341_color_12_t hsvTo12b( uint16_t h, uint8_t s, uint8_t v, uint8_t odd);
 
+	// Batch gradients - hue ramps step through each sextant incrementally, hsvRamp interpolates all three and evaluates each entry inline
+	static void hueRamp18b( ILI9341_color_18_t* pdst, uint16_t count, uint16_t h0, uint16_t h1, uint8_t s, uint8_t v );	// h0 to h1 inclusive, increasing hue with wrap around
+	static void hueRamp16b( ILI9341_color_16_t* pdst, uint16_t count, uint16_t h0, uint16_t h1, uint8_t s, uint8_t v );
+	static void hueWheel18b( ILI9341_color_18_t* pdst, uint16_t count, uint8_t s, uint8_t v );	// count evenly spaced hues all the way round, HSV_HUE_STEPS gives every hue
+	static void hueWheel16b( ILI9341_color_16_t* pdst, uint16_t count, uint8_t s, uint8_t v );
+	static void hsvRamp18b( ILI9341_color_18_t* pdst, uint16_t count, uint16_t h0, uint8_t s0, uint8_t v0, uint16_t h1, uint8_t s1, uint8_t v1 );
+	static void hsvRamp16b( ILI9341_color_16_t* pdst, uint16_t count, uint16_t h0, uint8_t s0, uint8_t v0, uint16_t h1, uint8_t s1, uint8_t v1 );
+
 	static ILI9341_color_18_t rgbTo18b( uint8_t r, uint8_t g, uint8_t b );
 	static ILI9341_color_16_t rgbTo16b( uint8_t r, uint8_t g, uint8_t b );
 	static ILI9341_color_12_t rgbTo12b( uint8_t r, uint8_t g, uint8_t b, uint8_t odd);
+	static uint16_t rgbTo565( uint8_t r, uint8_t g, uint8_t b );		// Native uint16_t 565, for use with setNativeEndian(true)
 
 	// Low-level interface functions to be defined in derived classes:
 	virtual ILI9341_STAT_t writePacket(ILI9341_CMD_t* pcmd = NULL, uint8_t* pdata = NULL, uint16_t dlen = 0) = 0;		// This function sends any combination of one command and or dlen data byes
-	// virtual ILI9341_STAT_t readPacket(ILI9341_CMD_t* pcmd = NULL, uint8_t* pdata = NULL, uint8_t dlen = 0) = 0;
+	virtual ILI9341_STAT_t readPacket(ILI9341_CMD_t* pcmd = NULL, uint8_t* pdata = NULL, uint16_t dlen = 0, uint8_t dummyBytes = 0);	// Sends one command then reads dlen bytes after skipping dummyBytes, backends without a read path return an error
 
 	// Some Utility Functions
 	uint8_t getBytesPerPixel( void );
 
+	// Scratch arena used to build pixel streams - place it in DMA-capable RAM or shrink it to suit small task stacks
+	ILI9341_STAT_t setScratchBuffer( uint8_t* buff, size_t size );	// Pass NULL to go back to the default static arena
+	uint8_t* getScratch( size_t* size );								// Borrow the arena for arbitrary data
+	uint8_t* replicateColor( color_t color, hd_pixels_t* numPixels );	// Fill the arena with copies of one color, skipped if it is already there
+
+	// Pixel byte order - in native mode 16 bit colors, arrays and cycles are plain uint16_t and get put into wire order on the way out
+	void setNativeEndian( bool native );
+	bool getNativeEndian( void );
+	void loadPixel( uint8_t* pdst, color_t color );						// Copies one color into a stream in wire order
+	static void swap565( uint8_t* pdata, hd_pixels_t numPixels );		// Byte swaps 565 pixels in place, a word at a time
+
 
 	// Basic Control Functions
 	ILI9341_STAT_t swReset( void );
@@ -196,10 +295,42 @@ public:
 	ILI9341_STAT_t setColumnAddress( uint16_t start, uint16_t end );
 	ILI9341_STAT_t setRowAddress( uint16_t start, uint16_t end );
 	ILI9341_STAT_t writeToRAM( uint8_t* pdata, uint16_t numBytes );
+	ILI9341_STAT_t readRAM( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, uint8_t* pdata, hd_pixels_t numPixels );	// Always three bytes per pixel, six bits each in the top of the byte
+
+	// Windowed RAM access - set a window once then stream any number of pixel bytes into it
+	ILI9341_STAT_t setWindow( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1 );
+	virtual ILI9341_STAT_t startRAMWrite( void );										// Sends the RAM write command
+	virtual ILI9341_STAT_t continueRAMWrite( uint8_t* pdata, size_t numBytes );			// Sends pixel data, may be called many times per window
+	virtual ILI9341_STAT_t continuePixelWrite( const uint8_t* pdata, hd_pixels_t numPixels );	// Sends application pixels, which may be in native order
+	virtual ILI9341_STAT_t stopRAMWrite( void );
+	virtual ILI9341_STAT_t waitForBus( void );											// Backends that finish transfers asynchronously (DMA) block here until the bus is free
+	virtual ILI9341_STAT_t startBatch( void );											// Holds the bus across many small windows, until stopBatch
+	virtual ILI9341_STAT_t stopBatch( void );
+	ILI9341_STAT_t streamColorCycle( color_t data, hd_pixels_t numPixels, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0 );	// Expands the cycle once and streams it in large chunks
+	ILI9341_STAT_t hwfillFromArrayScaled( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data, hd_hw_extent_t srcWidth, hd_hw_extent_t srcHeight );	// Nearest-neighbour stretch of a srcWidth x srcHeight array over the window, never materialized
+
+	// Clipping - hw primitives, hwfillFromArrayScaled, hwtext and queued draws are trimmed to the top of the stack before they touch the bus, in hardware coordinates.
+	// Helpers that open their own windows (CharGrid, JPEG, dither, video and anti-aliased spans) are not clipped
+	ILI9341_STAT_t pushClip( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1 );	// Intersects with the current clip
+	ILI9341_STAT_t popClip( void );
+	void resetClip( void );
+	bool getClip( ILI9341_clip_t* clip );		// False when there is no clip in effect
+
+	// Text - each line of a string is rasterized a row at a time into one window (more for long lines), including the background
+	void setGlyphCache( ILI9341_glyph_cache_t* cache );
+	void clearGlyphCache( void );
+	const ILI9341_glyph_t* getGlyph( uint8_t code, ILI9341_glyph_t* scratch );
+	hd_hw_extent_t hwtext( hd_hw_extent_t x0, hd_hw_extent_t y0, const char* str, color_t fg, color_t bg );
+	hd_hw_extent_t text( hd_extent_t x0, hd_extent_t y0, const char* str, color_t fg, color_t bg );
+
+	// Buffered windows - sends the rows drawn since the last call, each run of them as one hwfillFromArray
+	ILI9341_STAT_t showWindow( wind_info_t* wind = NULL );	// Defaults to the current window
 	
 	
 	// Functions to configure the display fully
 	ILI9341_STAT_t setMemoryAccessControl( bool mx, bool my, bool mv, bool ml, bool bgr, bool mh );
+	ILI9341_STAT_t setRotation( uint16_t degrees );	// 0, 90, 180 or 270 - swaps xExt and yExt as needed
+	uint16_t getRotation( void );
 	ILI9341_STAT_t selectGammaCurve( uint8_t bmNumber );
 	ILI9341_STAT_t setPartialArea(uint16_t start, uint16_t end );
 	ILI9341_STAT_t setVerticalScrolling( uint16_t tfa, uint16_t vsa, uint16_t bfa );
@@ -292,6 +423,28 @@ instantiate an object of this class.
 
 #define ILI9341_SPI_DEFAULT_FREQ 24000000
 #define ILI9341_SPI_MAX_FREQ 	32000000
+#define ILI9341_SPI_READ_FREQ 	6000000		// Memory reads need a much longer clock cycle than writes
+
+#define ILI9341_SPI_CAL_MIN_FREQ 4000000
+#define ILI9341_SPI_CAL_MAX_FREQ 80000000
+#define ILI9341_SPI_CAL_STEP 	4000000
+#define ILI9341_SPI_CAL_MARGIN 	10			// Percent taken off the fastest clock that passed
+#ifndef ILI9341_SPI_CAL_PIXELS
+#define ILI9341_SPI_CAL_PIXELS 	32			// Length of the row of GRAM that calibration overwrites
+#endif
+
+typedef struct ILI9341_spi_cal{
+	uint32_t maxWriteFreq;		// Fastest clocks with no errors, zero if none did
+	uint32_t maxReadFreq;
+	uint32_t writeFreq;			// What was applied, after the margin
+	uint32_t readFreq;
+	uint16_t writeErrors;		// Bytes that differed at the first failing write clock
+	uint16_t readErrors;
+	bool writeLimited;			// True when the sweep hit maxFreq rather than an error
+	bool readLimited;
+}ILI9341_spi_cal_t;
+
+class ILI9341_BusScheduler;
 
 class ILI9341_4WSPI : public ILI9341{									// General for use with Arduino / SPI with arbitrary display size
 private:
@@ -302,18 +455,49 @@ protected:
 	uint8_t _dc, _rst, _cs;		// Pin definitions
 	SPIClass * _spi;			// Which SPI port to use
 	SPISettings _spisettings;
+	uint32_t _spiFreq;
+	SPISettings _readsettings;
+	uint32_t _spiReadFreq;
+	ILI9341_spi_cal_t _cal;
+
+	uint16_t checkPattern( hd_hw_extent_t x0, hd_hw_extent_t y0, uint8_t seed, uint32_t cmdFreq, uint32_t writeFreq, uint32_t readFreq );	// Returns the number of bad bytes
+
+	bool _batch;						// Between startBatch and stopBatch the bus is already held, so packets skip the setup
+	ILI9341_BusScheduler* _scheduler;	// When set, RAM writes are sliced so other bus clients get a turn
+	uint8_t _schedulerClient;
+	size_t _sliceBytesLeft;
+	bool _yielded;						// Inside yieldBus, when this display's own bus calls fail
+	ILI9341_scratch_t _yieldScratch;	// Stands in for the arena while yielded
+	uint8_t _yieldBuff[ILI9341_MAX_BPP];
+
+	void yieldBus( void );
+	virtual void retuneSPI( void );		// Puts a new setSPIFreq into effect in the middle of a RAM write
 
 public:
 	ILI9341_STAT_t writePacket(ILI9341_CMD_t* pcmd = NULL, uint8_t* pdata = NULL, uint16_t dlen = 0);
+	ILI9341_STAT_t readPacket(ILI9341_CMD_t* pcmd = NULL, uint8_t* pdata = NULL, uint16_t dlen = 0, uint8_t dummyBytes = 0);
 	ILI9341_STAT_t selectDriver( void );
 	ILI9341_STAT_t deselectDriver( void );
 	ILI9341_STAT_t setSPIFreq( uint32_t freq );
+	ILI9341_STAT_t setSPIReadFreq( uint32_t freq );
+	uint32_t getSPIFreq( void );
+	uint32_t getSPIReadFreq( void );
+
+	// Clock calibration - writes test patterns into one row of GRAM at rising clocks and reads them back, the row is left overwritten
+	ILI9341_STAT_t calibrateSPI( hd_hw_extent_t x0, hd_hw_extent_t y0, uint32_t minFreq = ILI9341_SPI_CAL_MIN_FREQ, uint32_t maxFreq = ILI9341_SPI_CAL_MAX_FREQ, uint32_t step = ILI9341_SPI_CAL_STEP, uint8_t marginPercent = ILI9341_SPI_CAL_MARGIN );
+	const ILI9341_spi_cal_t* getCalibration( void );
+	ILI9341_STAT_t setBusScheduler( ILI9341_BusScheduler* scheduler );	// Needs a scratch arena of its own (setScratchBuffer). Pass NULL to hold the bus for whole transfers again
+	ILI9341_STAT_t startRAMWrite( void );
+	ILI9341_STAT_t continueRAMWrite( uint8_t* pdata, size_t numBytes );
+	ILI9341_STAT_t stopRAMWrite( void );
+	ILI9341_STAT_t startBatch( void );
+	ILI9341_STAT_t stopBatch( void );
 	virtual ILI9341_STAT_t transferSPIbuffer(uint8_t* pdata, size_t count, bool arduinoStillBroken );	// This function is necessary only because Arduino's built-in SPI.transfer() function is broken for one-way transfers. (It overwrites the TX data with whatever was received on RX at the time)
 
 
 	virtual void 	hwxline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t len, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool goLeft = false);
 	virtual void    hwyline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t len, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool goUp = false);
-	// virtual void 	hwrectangle(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, bool filled = false, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool reverseGradient = false, bool gradientVertical = false); 
+	virtual void 	hwrectangle(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, bool filled = false, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool reverseGradient = false, bool gradientVertical = false); 
 	virtual void 	hwfillFromArray(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data = NULL, hd_pixels_t numPixels = 0, bool Vh = false);
 
 };
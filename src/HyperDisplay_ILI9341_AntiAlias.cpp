@@ -0,0 +1,277 @@
+#include "HyperDisplay_ILI9341_AntiAlias.h"
+
+#include <math.h>
+
+
+ILI9341_AntiAlias::ILI9341_AntiAlias( ILI9341* target )
+{
+	_target = target;
+	_bpp = 0;
+	_spans = 0;
+}
+
+ILI9341_STAT_t ILI9341_AntiAlias::setColors( color_t fg, color_t bg )
+{
+	_bpp = _target->getBytesPerPixel();
+	if((fg == NULL) || (bg == NULL) || (_bpp == 0)){ _bpp = 0; return ILI9341_STAT_Error; }
+
+	// The ramp goes straight to the bus, so build it in wire order whatever order the colors came in
+	uint8_t fgPixel[ILI9341_MAX_BPP];
+	_target->loadPixel(fgPixel, fg);
+	for(uint8_t level = 0; level <= ILI9341_AA_LEVELS; level++)
+	{
+		uint8_t* pentry = _ramp + (level*_bpp);
+		uint8_t alpha = (uint8_t)((level*255)/ILI9341_AA_LEVELS);
+		_target->loadPixel(pentry, bg);
+		if( _bpp == 2 ){ ILI9341_Compositor::blend565(pentry, fgPixel, NULL, alpha, 1); }
+		else{ ILI9341_Compositor::blend666(pentry, fgPixel, NULL, alpha, 1); }
+	}
+	return ILI9341_STAT_Nominal;
+}
+
+float ILI9341_AntiAlias::coverage( const ILI9341_aa_shape_t* shape, float x, float y )
+{
+	float dist = 0.0;
+	float dx = x - shape->x0;
+	float dy = y - shape->y0;
+	switch( shape->type )
+	{
+		case ILI9341_AA_Line :
+		{
+			float lx = shape->x1 - shape->x0;
+			float ly = shape->y1 - shape->y0;
+			float len2 = (lx*lx) + (ly*ly);
+			float t = (len2 > 0.0) ? (((dx*lx) + (dy*ly))/len2) : 0.0;
+			if((t > 0.0) && (t < 1.0))
+			{
+				dist = fabsf((dx*ly) - (dy*lx))/sqrtf(len2);		// Along the body the distance is just the cross product
+			}
+			else
+			{
+				if( t >= 1.0 ){ dx = x - shape->x1; dy = y - shape->y1; }
+				dist = sqrtf((dx*dx) + (dy*dy));
+			}
+			break;
+		}
+
+		case ILI9341_AA_Ring :
+			dist = fabsf(sqrtf((dx*dx) + (dy*dy)) - shape->radius);
+			break;
+
+		case ILI9341_AA_Disc :
+			dist = sqrtf((dx*dx) + (dy*dy)) - shape->radius;		// Negative inside, which saturates the coverage
+			break;
+
+		case ILI9341_AA_Arc :
+		{
+			float angle = atan2f(dy, dx)*(180.0/M_PI) - shape->start;
+			while( angle < 0.0 ){ angle += 360.0; }
+			while( angle >= 360.0 ){ angle -= 360.0; }
+			if( angle <= shape->sweep )
+			{
+				dist = fabsf(sqrtf((dx*dx) + (dy*dy)) - shape->radius);
+			}
+			else
+			{
+				// Outside the sweep the nearest point is one of the ends, which rounds them off
+				float a0 = shape->start*(M_PI/180.0);
+				float a1 = (shape->start + shape->sweep)*(M_PI/180.0);
+				float ex = dx - (shape->radius*cosf(a0));
+				float ey = dy - (shape->radius*sinf(a0));
+				float d0 = (ex*ex) + (ey*ey);
+				ex = dx - (shape->radius*cosf(a1));
+				ey = dy - (shape->radius*sinf(a1));
+				float d1 = (ex*ex) + (ey*ey);
+				dist = sqrtf((d0 < d1) ? d0 : d1);
+			}
+			break;
+		}
+
+		default :
+			return 0.0;
+	}
+
+	float cov = shape->halfWidth + 0.5 - dist;
+	if( cov <= 0.0 ){ return 0.0; }
+	if( cov >= 1.0 ){ return 1.0; }
+	return cov;
+}
+
+uint8_t ILI9341_AntiAlias::candidates( const ILI9341_aa_shape_t* shape, float y, int16_t* x0, int16_t* x1 )
+{
+	// Up to two ranges of x on row y that could have any coverage at all
+	float reach = shape->halfWidth + 1.0;
+	float lo, hi;
+	if( shape->type == ILI9341_AA_Line )
+	{
+		lo = ((shape->x0 < shape->x1) ? shape->x0 : shape->x1) - reach;
+		hi = ((shape->x0 < shape->x1) ? shape->x1 : shape->x0) + reach;
+
+		// Trim to the strip around the line unless it is close to horizontal
+		float lx = shape->x1 - shape->x0;
+		float ly = shape->y1 - shape->y0;
+		if( fabsf(ly) > 0.01 )
+		{
+			float xc = shape->x0 + ((y - shape->y0)*lx/ly);
+			float half = reach*sqrtf((lx*lx) + (ly*ly))/fabsf(ly);
+			if((xc - half) > lo){ lo = xc - half; }
+			if((xc + half) < hi){ hi = xc + half; }
+		}
+		if( hi < lo ){ return 0; }
+		x0[0] = (int16_t)floorf(lo);
+		x1[0] = (int16_t)ceilf(hi);
+		return 1;
+	}
+
+	float dy = y - shape->y0;
+	float outer = shape->radius + reach;
+	float o2 = (outer*outer) - (dy*dy);
+	if( o2 < 0.0 ){ return 0; }
+	float ox = sqrtf(o2);
+	x0[0] = (int16_t)floorf(shape->x0 - ox);
+	x1[0] = (int16_t)ceilf(shape->x0 + ox);
+	if( shape->type == ILI9341_AA_Disc ){ return 1; }
+
+	float inner = shape->radius - reach;
+	float i2 = (inner*inner) - (dy*dy);
+	if((inner <= 0.0) || (i2 <= 0.0)){ return 1; }
+	float ix = sqrtf(i2);
+	x1[1] = x1[0];
+	x1[0] = (int16_t)ceilf(shape->x0 - ix);
+	x0[1] = (int16_t)floorf(shape->x0 + ix);
+	return 2;
+}
+
+ILI9341_STAT_t ILI9341_AntiAlias::sendSpan( hd_hw_extent_t x0, hd_hw_extent_t y, uint8_t* data, hd_pixels_t numPixels )
+{
+	ILI9341_STAT_t retval = _target->setWindow(x0, y, x0 + (numPixels - 1), y);
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	_target->startRAMWrite();
+	retval = _target->continueRAMWrite(data, (size_t)numPixels*_bpp);
+	_target->stopRAMWrite();
+	_spans++;
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341_AntiAlias::rasterize( const ILI9341_aa_shape_t* shape )
+{
+	if( _bpp == 0 ){ return ILI9341_STAT_Error; }		// setColors first
+
+	size_t size = 0;
+	uint8_t* scratch = _target->getScratch(&size);
+	hd_pixels_t capacity = size/_bpp;
+	if( capacity == 0 ){ return ILI9341_STAT_Error; }
+
+	float extent = shape->halfWidth + 1.0;
+	float top, bottom;
+	if( shape->type == ILI9341_AA_Line )
+	{
+		top = ((shape->y0 < shape->y1) ? shape->y0 : shape->y1) - extent;
+		bottom = ((shape->y0 < shape->y1) ? shape->y1 : shape->y0) + extent;
+	}
+	else
+	{
+		top = shape->y0 - (shape->radius + extent);
+		bottom = shape->y0 + (shape->radius + extent);
+	}
+	int16_t ymin = (top < 0.0) ? 0 : (int16_t)floorf(top);
+	int16_t ymax = (bottom > (float)(_target->yExt - 1)) ? (_target->yExt - 1) : (int16_t)ceilf(bottom);
+	int16_t xlast = _target->xExt - 1;
+
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	for(int16_t y = ymin; y <= ymax; y++)
+	{
+		int16_t lo[2], hi[2];
+		uint8_t ranges = candidates(shape, (float)y, lo, hi);
+		for(uint8_t range = 0; range < ranges; range++)
+		{
+			if( lo[range] < 0 ){ lo[range] = 0; }
+			if( hi[range] > xlast ){ hi[range] = xlast; }
+
+			// Collect runs of covered pixels and send each as one span
+			int16_t runStart = -1;
+			hd_pixels_t runLen = 0;
+			for(int16_t x = lo[range]; x <= hi[range] + 1; x++)
+			{
+				uint8_t level = 0;
+				if( x <= hi[range] ){ level = (uint8_t)((coverage(shape, (float)x, (float)y)*ILI9341_AA_LEVELS) + 0.5); }
+				if( level != 0 )
+				{
+					if( runStart < 0 ){ runStart = x; }
+					memcpy(scratch + (runLen*_bpp), _ramp + (level*_bpp), _bpp);
+					runLen++;
+				}
+				if((runLen != 0) && ((level == 0) || (runLen == capacity)))
+				{
+					if( sendSpan(runStart, y, scratch, runLen) != ILI9341_STAT_Nominal ){ retval = ILI9341_STAT_Error; }
+					runStart = (level == 0) ? -1 : (x + 1);
+					runLen = 0;
+				}
+			}
+		}
+	}
+	return retval;
+}
+
+
+
+// Primitives
+ILI9341_STAT_t ILI9341_AntiAlias::line( float x0, float y0, float x1, float y1, float width )
+{
+	ILI9341_aa_shape_t shape;
+	shape.type = ILI9341_AA_Line;
+	shape.x0 = x0;
+	shape.y0 = y0;
+	shape.x1 = x1;
+	shape.y1 = y1;
+	shape.radius = 0.0;
+	shape.halfWidth = width/2;
+	return rasterize(&shape);
+}
+
+ILI9341_STAT_t ILI9341_AntiAlias::circle( float x0, float y0, float radius, float width )
+{
+	ILI9341_aa_shape_t shape;
+	shape.type = ILI9341_AA_Ring;
+	shape.x0 = x0;
+	shape.y0 = y0;
+	shape.radius = radius;
+	shape.halfWidth = width/2;
+	return rasterize(&shape);
+}
+
+ILI9341_STAT_t ILI9341_AntiAlias::fillCircle( float x0, float y0, float radius )
+{
+	ILI9341_aa_shape_t shape;
+	shape.type = ILI9341_AA_Disc;
+	shape.x0 = x0;
+	shape.y0 = y0;
+	shape.radius = radius;
+	shape.halfWidth = 0.0;
+	return rasterize(&shape);
+}
+
+ILI9341_STAT_t ILI9341_AntiAlias::arc( float x0, float y0, float radius, float startDeg, float endDeg, float width )
+{
+	ILI9341_aa_shape_t shape;
+	shape.type = ILI9341_AA_Arc;
+	shape.x0 = x0;
+	shape.y0 = y0;
+	shape.radius = radius;
+	shape.halfWidth = width/2;
+	shape.start = startDeg;
+	shape.sweep = endDeg - startDeg;
+	while( shape.sweep < 0.0 ){ shape.sweep += 360.0; }
+	while( shape.sweep > 360.0 ){ shape.sweep -= 360.0; }
+	return rasterize(&shape);
+}
+
+uint32_t ILI9341_AntiAlias::getSpanCount( void )
+{
+	return _spans;
+}
+
+void ILI9341_AntiAlias::resetSpanCount( void )
+{
+	_spans = 0;
+}
@@ -0,0 +1,86 @@
+/*
+
+Anti-aliased primitives for HyperDisplay ILI9341 - lines, circles,
+discs and arcs drawn from the distance between each pixel and the 
+ideal shape, blended against a known background color. Rather than
+setting pixels one by one every row is cut into spans of covered
+pixels and each span goes out as one window, with its colors looked
+up from a ramp that is computed once per color pair.
+
+Coordinates are in hardware pixels and may be fractional, which is 
+what lets a gauge needle move smoothly.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_ANTIALIAS_H
+#define HPYERDISPLAY_ILI9341_ANTIALIAS_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+#include "HyperDisplay_ILI9341_Compositor.h"		// For the blending kernels
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_AA_LEVELS
+#define ILI9341_AA_LEVELS 16			// Coverage steps between background and foreground
+#endif
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef enum{
+	ILI9341_AA_Line = 0x00,
+	ILI9341_AA_Ring,
+	ILI9341_AA_Disc,
+	ILI9341_AA_Arc
+}ILI9341_AA_t;
+
+typedef struct ILI9341_aa_shape{
+	ILI9341_AA_t type;
+	float x0;					// Line start or center
+	float y0;
+	float x1;					// Line end
+	float y1;
+	float radius;
+	float halfWidth;
+	float start;				// Arc start and sweep in degrees, clockwise from +x
+	float sweep;
+}ILI9341_aa_shape_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_AntiAlias{
+private:
+protected:
+	ILI9341* _target;
+	uint8_t _ramp[(ILI9341_AA_LEVELS + 1)*ILI9341_MAX_BPP];	// Background to foreground in wire format
+	uint8_t _bpp;
+	uint32_t _spans;
+
+	float coverage( const ILI9341_aa_shape_t* shape, float x, float y );
+	uint8_t candidates( const ILI9341_aa_shape_t* shape, float y, int16_t* x0, int16_t* x1 );
+	ILI9341_STAT_t sendSpan( hd_hw_extent_t x0, hd_hw_extent_t y, uint8_t* data, hd_pixels_t numPixels );
+	ILI9341_STAT_t rasterize( const ILI9341_aa_shape_t* shape );
+
+public:
+	ILI9341_AntiAlias( ILI9341* target );
+
+	ILI9341_STAT_t setColors( color_t fg, color_t bg );		// Must be called again if the pixel format changes
+
+	ILI9341_STAT_t line( float x0, float y0, float x1, float y1, float width = 1.0 );
+	ILI9341_STAT_t circle( float x0, float y0, float radius, float width = 1.0 );
+	ILI9341_STAT_t fillCircle( float x0, float y0, float radius );
+	ILI9341_STAT_t arc( float x0, float y0, float radius, float startDeg, float endDeg, float width = 1.0 );
+
+	uint32_t getSpanCount( void );			// Windows opened since the last reset
+	void resetSpanCount( void );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_ANTIALIAS_H */
@@ -0,0 +1,199 @@
+#include "HyperDisplay_ILI9341_BandPipeline.h"
+
+
+ILI9341_BandPipeline::ILI9341_BandPipeline( ILI9341* target, uint8_t* memory, size_t size, hd_hw_extent_t rowsPerBand )
+{
+	_target = target;
+	_rowsPerBand = rowsPerBand;
+	_numBuffers = 0;
+	_bandBytes = 0;
+	_diff = NULL;
+	_ready.head = 0;
+	_ready.tail = 0;
+	_free.head = 0;
+	_free.tail = 0;
+	_inFrame = false;
+#if !defined(ARDUINO)
+	_consumerRunning = false;
+#endif
+	resetStats();
+
+	if((target == NULL) || (memory == NULL) || (rowsPerBand == 0)){ return; }
+
+	size_t bandBytes = (size_t)target->xExt*rowsPerBand*target->getBytesPerPixel();
+	if( bandBytes == 0 ){ return; }
+	while( (_numBuffers < ILI9341_PIPELINE_BUFFERS) && (size >= bandBytes) )
+	{
+		_buffers[_numBuffers] = memory;
+		ringPush(&_free, _numBuffers);
+		memory += bandBytes;
+		size -= bandBytes;
+		_numBuffers++;
+	}
+	_bandBytes = bandBytes;
+}
+
+#if !defined(ARDUINO)
+ILI9341_BandPipeline::~ILI9341_BandPipeline( void )
+{
+	stopConsumerThread();
+}
+#endif
+
+uint8_t ILI9341_BandPipeline::getNumBuffers( void )
+{
+	return _numBuffers;
+}
+
+hd_hw_extent_t ILI9341_BandPipeline::getRowsPerBand( void )
+{
+	return _rowsPerBand;
+}
+
+void ILI9341_BandPipeline::setFrameDiff( ILI9341_FrameDiff* diff )
+{
+	_diff = diff;
+}
+
+bool ILI9341_BandPipeline::ringPush( ILI9341_band_ring_t* ring, uint8_t slot )
+{
+	uint8_t head = ring->head;
+	if( (uint8_t)(head - ILI9341_LOAD_ACQUIRE(&ring->tail)) >= ILI9341_PIPELINE_BUFFERS ){ return false; }
+	ring->slots[head & (ILI9341_PIPELINE_BUFFERS - 1)] = slot;
+	ILI9341_STORE_RELEASE(&ring->head, (uint8_t)(head + 1));
+	return true;
+}
+
+bool ILI9341_BandPipeline::ringPop( ILI9341_band_ring_t* ring, uint8_t* slot )
+{
+	uint8_t tail = ring->tail;
+	if( tail == ILI9341_LOAD_ACQUIRE(&ring->head) ){ return false; }
+	*slot = ring->slots[tail & (ILI9341_PIPELINE_BUFFERS - 1)];
+	ILI9341_STORE_RELEASE(&ring->tail, (uint8_t)(tail + 1));
+	return true;
+}
+
+
+
+// Producer side
+ILI9341_STAT_t ILI9341_BandPipeline::renderFrame( ILI9341_band_render_t render, void* context, bool inlineTransfer )
+{
+	if((render == NULL) || (_numBuffers == 0)){ return ILI9341_STAT_Error; }
+
+	hd_hw_extent_t width = _target->xExt;
+	hd_hw_extent_t height = _target->yExt;
+	if( (size_t)width*_rowsPerBand*_target->getBytesPerPixel() > _bandBytes ){ return ILI9341_STAT_Error; }		// Rotated or reformatted since the buffers were sized
+	ILI9341_STORE_RELEASE(&_inFrame, true);
+
+	for(hd_hw_extent_t y0 = 0; y0 < height; y0 += _rowsPerBand)
+	{
+		uint8_t slot = 0;
+		uint32_t start = micros();
+		while( !ringPop(&_free, &slot) )
+		{
+			if( inlineTransfer ){ service(); }		// Nobody else is going to empty the buffers
+			else{ ILI9341_SPIN_YIELD(); }
+		}
+		uint32_t got = micros();
+		_stats.renderStallMicros += (got - start);
+
+		hd_hw_extent_t rows = ((height - y0) < _rowsPerBand) ? (height - y0) : _rowsPerBand;
+		render(_buffers[slot], y0, rows, width, context);
+		_bandY0[slot] = y0;
+		_bandRows[slot] = rows;
+		_bandWidth[slot] = width;
+		_stats.renderMicros += (micros() - got);
+
+		ringPush(&_ready, slot);					// Can't fail, there are only as many slots as buffers
+	}
+	_stats.frames++;
+
+	if( inlineTransfer )
+	{
+		// The producer is the only consumer here, so it drains what is left itself
+		while( service() ){}
+	}
+	ILI9341_STORE_RELEASE(&_inFrame, false);
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_BandPipeline::finish( void )
+{
+	// All buffers are back on the free ring once the last band has gone out. Only the consumer pops the ready ring, so just watch
+	while( (uint8_t)(ILI9341_LOAD_ACQUIRE(&_free.head) - _free.tail) != _numBuffers )
+	{
+		ILI9341_SPIN_YIELD();
+	}
+}
+
+
+
+// Consumer side
+bool ILI9341_BandPipeline::service( void )
+{
+	uint8_t slot = 0;
+	uint32_t now = micros();
+	if( !ringPop(&_ready, &slot) )
+	{
+		if( ILI9341_LOAD_ACQUIRE(&_inFrame) ){ _stats.transferStallMicros += (now - _lastPoll); }
+		_lastPoll = now;
+		return false;
+	}
+
+	hd_hw_extent_t y0 = _bandY0[slot];
+	hd_hw_extent_t rows = _bandRows[slot];
+	hd_hw_extent_t width = _bandWidth[slot];		// As rendered, the buffer is only known to hold that much
+	if( _diff != NULL )
+	{
+		_diff->sendBand(_buffers[slot], y0, rows, width);
+	}
+	else
+	{
+		_target->hwfillFromArray(0, y0, width - 1, y0 + (rows - 1), (color_t)_buffers[slot], (hd_pixels_t)width*rows);
+	}
+
+	ringPush(&_free, slot);
+	_stats.bands++;
+	_lastPoll = micros();
+	_stats.transferMicros += (_lastPoll - now);
+	return true;
+}
+
+#if !defined(ARDUINO)
+ILI9341_STAT_t ILI9341_BandPipeline::startConsumerThread( void )
+{
+	if( _consumerRunning ){ return ILI9341_STAT_Error; }
+	ILI9341_STORE_RELEASE(&_consumerRunning, true);
+	_consumer = std::thread(&ILI9341_BandPipeline::consumerLoop, this);
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_BandPipeline::stopConsumerThread( void )
+{
+	if( !_consumerRunning ){ return; }
+	ILI9341_STORE_RELEASE(&_consumerRunning, false);
+	_consumer.join();
+}
+
+void ILI9341_BandPipeline::consumerLoop( void )
+{
+	while( ILI9341_LOAD_ACQUIRE(&_consumerRunning) )
+	{
+		if( !service() ){ ILI9341_SPIN_YIELD(); }
+	}
+}
+#endif
+
+
+
+// Instrumentation
+ILI9341_pipeline_stats_t ILI9341_BandPipeline::getStats( void )
+{
+	return _stats;
+}
+
+void ILI9341_BandPipeline::resetStats( void )
+{
+	memset(&_stats, 0x00, sizeof(_stats));
+	_lastPoll = micros();
+}
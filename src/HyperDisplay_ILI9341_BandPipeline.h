@@ -0,0 +1,123 @@
+/*
+
+Banded render/transfer pipeline for HyperDisplay ILI9341 - splits
+the screen into horizontal bands so that one core can render band
+N+1 while another streams band N to GRAM. Rendered bands and free
+buffers are handed between the two sides through a pair of bounded
+single producer / single consumer rings, and both sides keep track
+of how long they were busy and how long they stalled.
+
+On a single core pass inlineTransfer = true to renderFrame and the
+producer streams bands itself whenever it runs out of buffers. Host
+builds can hand the consumer side to a std::thread instead with
+startConsumerThread().
+
+Band buffers are sized for the panel width when the pipeline is made.
+A frame that no longer fits them (after a rotation to landscape, or a
+change to 18 bit pixels) is refused, so size the memory for the widest
+case up front if that is going to happen.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_BANDPIPELINE_H
+#define HPYERDISPLAY_ILI9341_BANDPIPELINE_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+#include "HyperDisplay_ILI9341_CommandQueue.h"		// For the atomic load and store macros
+#include "HyperDisplay_ILI9341_FrameDiff.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_PIPELINE_BUFFERS
+#define ILI9341_PIPELINE_BUFFERS 2		// Must be a power of two, two is enough for double buffering
+#endif
+#if ((ILI9341_PIPELINE_BUFFERS & (ILI9341_PIPELINE_BUFFERS - 1)) != 0) || (ILI9341_PIPELINE_BUFFERS > 128)
+#error "ILI9341_PIPELINE_BUFFERS must be a power of two no larger than 128"
+#endif
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef void (*ILI9341_band_render_t)(uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, void* context);	// Render rows y0 to y0+rows-1, row-major in the display's pixel format
+
+typedef struct ILI9341_pipeline_stats{
+	uint32_t frames;
+	uint32_t bands;
+	uint32_t renderMicros;			// Producer busy in the render callback
+	uint32_t renderStallMicros;		// Producer waiting for a free buffer
+	uint32_t transferMicros;		// Consumer busy streaming
+	uint32_t transferStallMicros;	// Consumer polled with nothing ready (only counted between bands of a frame)
+}ILI9341_pipeline_stats_t;
+
+typedef struct ILI9341_band_ring{
+	uint8_t slots[ILI9341_PIPELINE_BUFFERS];
+	uint8_t head;		// Written only by the side that fills the ring
+	uint8_t tail;		// Written only by the side that empties it
+}ILI9341_band_ring_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_BandPipeline{
+private:
+protected:
+	ILI9341* _target;
+	uint8_t* _buffers[ILI9341_PIPELINE_BUFFERS];
+	hd_hw_extent_t _bandY0[ILI9341_PIPELINE_BUFFERS];
+	hd_hw_extent_t _bandRows[ILI9341_PIPELINE_BUFFERS];
+	hd_hw_extent_t _bandWidth[ILI9341_PIPELINE_BUFFERS];
+	hd_hw_extent_t _rowsPerBand;
+	size_t _bandBytes;				// Size of each buffer
+	uint8_t _numBuffers;
+	ILI9341_FrameDiff* _diff;
+
+	ILI9341_band_ring_t _ready;		// Rendered bands, producer to consumer
+	ILI9341_band_ring_t _free;		// Empty buffers, consumer to producer
+
+	uint32_t _lastPoll;				// Consumer's timestamp for stall accounting
+	bool _inFrame;
+	ILI9341_pipeline_stats_t _stats;
+
+	static bool ringPush( ILI9341_band_ring_t* ring, uint8_t slot );
+	static bool ringPop( ILI9341_band_ring_t* ring, uint8_t* slot );
+
+#if !defined(ARDUINO)
+	std::thread _consumer;
+	bool _consumerRunning;
+	void consumerLoop( void );
+#endif
+
+public:
+	ILI9341_BandPipeline( ILI9341* target, uint8_t* memory, size_t size, hd_hw_extent_t rowsPerBand );	// memory is split into as many band buffers as fit, up to ILI9341_PIPELINE_BUFFERS
+#if !defined(ARDUINO)
+	~ILI9341_BandPipeline( void );
+#endif
+
+	uint8_t getNumBuffers( void );
+	hd_hw_extent_t getRowsPerBand( void );
+	void setFrameDiff( ILI9341_FrameDiff* diff );	// Consumer sends only what changed, NULL sends whole bands
+
+	// Producer side (core A)
+	ILI9341_STAT_t renderFrame( ILI9341_band_render_t render, void* context, bool inlineTransfer = false );	// Error when a band of the current width doesn't fit a buffer
+	void finish( void );			// Waits until every band handed over has been streamed by the consumer, not needed after an inline frame
+
+	// Consumer side (core B)
+	bool service( void );			// Streams one ready band, returns false if there was none
+#if !defined(ARDUINO)
+	ILI9341_STAT_t startConsumerThread( void );		// Calls service() from a std::thread until stopConsumerThread
+	void stopConsumerThread( void );
+#endif
+
+	// Instrumentation
+	ILI9341_pipeline_stats_t getStats( void );
+	void resetStats( void );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_BANDPIPELINE_H */
@@ -0,0 +1,122 @@
+#include "HyperDisplay_ILI9341_BusScheduler.h"
+
+
+ILI9341_BusScheduler::ILI9341_BusScheduler( uint32_t maxHoldMicros )
+{
+	_numClients = 0;
+	_next = 0;
+	_servicing = false;
+	_maxHoldMicros = maxHoldMicros;
+	resetStats();
+}
+
+int8_t ILI9341_BusScheduler::addClient( void )
+{
+	if( _numClients >= ILI9341_BUS_MAX_CLIENTS ){ return -1; }
+
+	_clients[_numClients].job = NULL;
+	_clients[_numClients].context = NULL;
+	_clients[_numClients].pending = false;
+	return (int8_t)(_numClients++);
+}
+
+ILI9341_STAT_t ILI9341_BusScheduler::submit( uint8_t client, ILI9341_bus_job_t job, void* context )
+{
+	if( client >= _numClients ){ return ILI9341_STAT_Error; }
+	if( job == NULL ){ return ILI9341_STAT_Error; }
+	if( _clients[client].pending ){ return ILI9341_STAT_Error; }	// One request per client at a time
+
+	_clients[client].job = job;
+	_clients[client].context = context;
+	_clients[client].pending = true;
+	return ILI9341_STAT_Nominal;
+}
+
+bool ILI9341_BusScheduler::isPending( uint8_t client )
+{
+	if( client >= _numClients ){ return false; }
+	return _clients[client].pending;
+}
+
+bool ILI9341_BusScheduler::runNext( uint8_t skip )
+{
+	// Give one slice to the next pending client after the last one served
+	for(uint8_t indi = 0; indi < _numClients; indi++)
+	{
+		uint8_t client = (_next + indi) % _numClients;
+		if( (client == skip) || !_clients[client].pending ){ continue; }
+
+		_next = (client + 1) % _numClients;
+		_clients[client].pending = _clients[client].job(_clients[client].context);
+		return true;
+	}
+	return false;
+}
+
+void ILI9341_BusScheduler::yield( uint8_t client )
+{
+	if( _servicing ){ return; }
+	_servicing = true;
+
+	// Every other client gets at most one slice, so the caller never waits more than one round
+	for(uint8_t indi = 1; indi < _numClients; indi++)
+	{
+		uint8_t other = (client + indi) % _numClients;
+		if( !_clients[other].pending ){ continue; }
+		_clients[other].pending = _clients[other].job(_clients[other].context);
+	}
+	_servicing = false;
+}
+
+void ILI9341_BusScheduler::service( void )
+{
+	if( _servicing ){ return; }
+	_servicing = true;
+	while( runNext(ILI9341_BUS_MAX_CLIENTS) ){}
+	_servicing = false;
+}
+
+void ILI9341_BusScheduler::setMaxHoldMicros( uint32_t micros )
+{
+	_maxHoldMicros = micros;
+}
+
+uint32_t ILI9341_BusScheduler::getMaxHoldMicros( void )
+{
+	return _maxHoldMicros;
+}
+
+uint32_t ILI9341_BusScheduler::getSliceBytes( uint32_t freq )
+{
+	uint32_t bytes = (uint32_t)(((uint64_t)freq * _maxHoldMicros) / 8000000);
+	if( bytes < ILI9341_BUS_MIN_SLICE_BYTES ){ bytes = ILI9341_BUS_MIN_SLICE_BYTES; }
+	return bytes;
+}
+
+void ILI9341_BusScheduler::beginHold( void )
+{
+	_holdStart = micros();
+}
+
+void ILI9341_BusScheduler::endHold( void )
+{
+	_lastHoldMicros = micros() - _holdStart;
+	if( _lastHoldMicros > _worstHoldMicros ){ _worstHoldMicros = _lastHoldMicros; }
+}
+
+uint32_t ILI9341_BusScheduler::getLastHoldMicros( void )
+{
+	return _lastHoldMicros;
+}
+
+uint32_t ILI9341_BusScheduler::getWorstHoldMicros( void )
+{
+	return _worstHoldMicros;
+}
+
+void ILI9341_BusScheduler::resetStats( void )
+{
+	_holdStart = 0;
+	_lastHoldMicros = 0;
+	_worstHoldMicros = 0;
+}
@@ -0,0 +1,91 @@
+/*
+
+Bus scheduler for HyperDisplay ILI9341 - shares one SPI port fairly
+between displays and other devices (SD cards, sensors...). Displays
+attached to a scheduler break long pixel streams into slices that 
+hold the bus for a bounded time and, between slices, let the other
+clients run one slice of their queued work each in round-robin order.
+
+A display picks up again with write memory continue, so nothing may
+touch it while it waits: it needs a scratch arena of its own (the
+default one is shared with every other display), and its own bus calls
+fail with ILI9341_STAT_Error until the stream resumes. Jobs should only
+draw on other devices.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_BUSSCHEDULER_H
+#define HPYERDISPLAY_ILI9341_BUSSCHEDULER_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_BUS_MAX_CLIENTS
+#define ILI9341_BUS_MAX_CLIENTS 6
+#endif
+#ifndef ILI9341_BUS_DEFAULT_HOLD_US
+#define ILI9341_BUS_DEFAULT_HOLD_US 2000		// Longest a display will hold the bus before giving others a turn
+#endif
+#ifndef ILI9341_BUS_MIN_SLICE_BYTES
+#define ILI9341_BUS_MIN_SLICE_BYTES 64			// Slices are never made smaller than this, however short the hold time
+#endif
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef bool (*ILI9341_bus_job_t)(void* context);	// Does one bounded slice of bus work, returns true while there is more to do
+
+typedef struct ILI9341_bus_client{
+	ILI9341_bus_job_t job;
+	void* context;
+	bool pending;
+}ILI9341_bus_client_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_BusScheduler{
+private:
+protected:
+	ILI9341_bus_client_t _clients[ILI9341_BUS_MAX_CLIENTS];
+	uint8_t _numClients;
+	uint8_t _next;					// Where the round-robin picks up
+	bool _servicing;				// Jobs run from inside a yield don't get to yield themselves
+
+	uint32_t _maxHoldMicros;
+	uint32_t _holdStart;
+	uint32_t _lastHoldMicros;
+	uint32_t _worstHoldMicros;
+
+	bool runNext( uint8_t skip );
+
+public:
+	ILI9341_BusScheduler( uint32_t maxHoldMicros = ILI9341_BUS_DEFAULT_HOLD_US );
+
+	int8_t addClient( void );												// Returns the client id, or -1 when full
+	ILI9341_STAT_t submit( uint8_t client, ILI9341_bus_job_t job, void* context );
+	bool isPending( uint8_t client );
+
+	void yield( uint8_t client );		// Called by the client holding the bus between slices - runs one slice for every other pending client
+	void service( void );				// Runs all queued work to completion, round-robin
+
+	// Hold time - configure the bound and measure what actually happens
+	void setMaxHoldMicros( uint32_t micros );
+	uint32_t getMaxHoldMicros( void );
+	uint32_t getSliceBytes( uint32_t freq );	// How many bytes fit in the hold time at a given clock
+	void beginHold( void );
+	void endHold( void );
+	uint32_t getLastHoldMicros( void );
+	uint32_t getWorstHoldMicros( void );
+	void resetStats( void );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_BUSSCHEDULER_H */
@@ -0,0 +1,274 @@
+#include "HyperDisplay_ILI9341_CharGrid.h"
+
+
+ILI9341_CharGrid::ILI9341_CharGrid( ILI9341* target, uint8_t* cells, uint8_t* attrs, uint8_t cols, uint8_t rows, uint8_t cellWidth, uint8_t cellHeight )
+{
+	_target = target;
+	_cells = cells;
+	_attrs = attrs;
+	_cols = cols;
+	_rows = rows;
+	if((cols != 0) && ((uint16_t)cols*rows > ILI9341_GRID_MAX_CELLS)){ _rows = ILI9341_GRID_MAX_CELLS/cols; }
+	if((cells == NULL) || (attrs == NULL)){ _rows = 0; }
+	_cellWidth = (cellWidth > ILI9341_GLYPH_MAX_W) ? ILI9341_GLYPH_MAX_W : cellWidth;	// Cell rows are expanded as 16 bit masks like glyphs
+	_cellHeight = cellHeight;
+	_x0 = 0;
+	_y0 = 0;
+	memset(_palette, 0x00, sizeof(_palette));
+	_bpp = 0;
+	_tiles = NULL;
+	_firstTile = 0;
+	_numTiles = 0;
+	invalidate();
+}
+
+void ILI9341_CharGrid::setOrigin( hd_hw_extent_t x0, hd_hw_extent_t y0 )
+{
+	_x0 = x0;
+	_y0 = y0;
+	invalidate();
+}
+
+ILI9341_STAT_t ILI9341_CharGrid::setPalette( color_t colors, uint8_t numColors )
+{
+	_bpp = _target->getBytesPerPixel();
+	if((colors == NULL) || (_bpp == 0)){ _bpp = 0; return ILI9341_STAT_Error; }
+	if( numColors > ILI9341_GRID_PALETTE ){ numColors = ILI9341_GRID_PALETTE; }
+
+	memset(_palette, 0x00, sizeof(_palette));
+	for(uint8_t indi = 0; indi < numColors; indi++)
+	{
+		_target->loadPixel(_palette + (indi*_bpp), _target->getOffsetColor(colors, indi));
+	}
+	invalidate();
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_CharGrid::setTiles( const uint8_t* bitmaps, uint8_t firstCode, uint16_t numTiles )
+{
+	_tiles = bitmaps;
+	_firstTile = firstCode;
+	_numTiles = (bitmaps == NULL) ? 0 : numTiles;
+	invalidate();
+}
+
+uint8_t ILI9341_CharGrid::getCols( void )
+{
+	return _cols;
+}
+
+uint8_t ILI9341_CharGrid::getRows( void )
+{
+	return _rows;
+}
+
+
+
+// Cell access
+void ILI9341_CharGrid::markDirty( uint16_t cell )
+{
+	uint8_t mask = (uint8_t)(1 << (cell & 0x07));
+	if( _dirty[cell >> 3] & mask ){ return; }
+	_dirty[cell >> 3] |= mask;
+	_numDirty++;
+}
+
+bool ILI9341_CharGrid::isDirty( uint16_t cell )
+{
+	return (_dirty[cell >> 3] & (1 << (cell & 0x07))) != 0;
+}
+
+void ILI9341_CharGrid::putChar( uint8_t col, uint8_t row, uint8_t code, uint8_t attr )
+{
+	if((col >= _cols) || (row >= _rows)){ return; }
+	uint16_t cell = ((uint16_t)row*_cols) + col;
+	if((_cells[cell] == code) && (_attrs[cell] == attr)){ return; }		// Unchanged cells cost nothing
+	_cells[cell] = code;
+	_attrs[cell] = attr;
+	markDirty(cell);
+}
+
+uint8_t ILI9341_CharGrid::print( uint8_t col, uint8_t row, const char* str, uint8_t attr )
+{
+	if( str == NULL ){ return 0; }
+	uint8_t written = 0;
+	while( (*str != '\0') && (col < _cols) )
+	{
+		putChar(col++, row, (uint8_t)*(str++), attr);
+		written++;
+	}
+	return written;
+}
+
+void ILI9341_CharGrid::setAttr( uint8_t col, uint8_t row, uint8_t attr )
+{
+	if((col >= _cols) || (row >= _rows)){ return; }
+	uint16_t cell = ((uint16_t)row*_cols) + col;
+	putChar(col, row, _cells[cell], attr);
+}
+
+uint8_t ILI9341_CharGrid::getChar( uint8_t col, uint8_t row )
+{
+	if((col >= _cols) || (row >= _rows)){ return 0; }
+	return _cells[((uint16_t)row*_cols) + col];
+}
+
+uint8_t ILI9341_CharGrid::getAttr( uint8_t col, uint8_t row )
+{
+	if((col >= _cols) || (row >= _rows)){ return 0; }
+	return _attrs[((uint16_t)row*_cols) + col];
+}
+
+void ILI9341_CharGrid::clear( uint8_t code, uint8_t attr )
+{
+	for(uint8_t row = 0; row < _rows; row++)
+	{
+		for(uint8_t col = 0; col < _cols; col++){ putChar(col, row, code, attr); }
+	}
+}
+
+void ILI9341_CharGrid::scrollUp( uint8_t attr )
+{
+	if( _rows == 0 ){ return; }
+
+	// Moved the long way round so that cells which come out the same (blank space, borders) stay clean
+	for(uint8_t row = 0; row + 1 < _rows; row++)
+	{
+		for(uint8_t col = 0; col < _cols; col++)
+		{
+			uint16_t below = ((uint16_t)(row + 1)*_cols) + col;
+			putChar(col, row, _cells[below], _attrs[below]);
+		}
+	}
+	for(uint8_t col = 0; col < _cols; col++){ putChar(col, _rows - 1, ' ', attr); }
+}
+
+void ILI9341_CharGrid::invalidate( void )
+{
+	memset(_dirty, 0xFF, sizeof(_dirty));
+	_numDirty = (uint16_t)_cols*_rows;
+}
+
+uint16_t ILI9341_CharGrid::getDirtyCount( void )
+{
+	return _numDirty;
+}
+
+
+
+// Rendering
+void ILI9341_CharGrid::expandCell( uint8_t code, uint8_t* pmask, uint8_t height )
+{
+	// Row masks go in as byte pairs, low byte first, so the arena needs no alignment
+	if((_tiles != NULL) && (code >= _firstTile) && ((uint16_t)(code - _firstTile) < _numTiles))
+	{
+		uint8_t rowBytes = (_cellWidth + 7)/8;
+		const uint8_t* prow = _tiles + ((size_t)(code - _firstTile)*_cellHeight*rowBytes);
+		for(uint8_t row = 0; row < height; row++, prow += rowBytes)
+		{
+			*(pmask++) = prow[0];
+			*(pmask++) = (rowBytes > 1) ? prow[1] : 0x00;
+		}
+		return;
+	}
+	ILI9341_glyph_t scratch;
+	const ILI9341_glyph_t* glyph = _target->getGlyph(code, &scratch);
+	for(uint8_t row = 0; row < height; row++)
+	{
+		uint16_t bits = (row < glyph->height) ? glyph->rows[row] : 0x0000;
+		*(pmask++) = (uint8_t)bits;
+		*(pmask++) = (uint8_t)(bits >> 8);
+	}
+}
+
+uint8_t ILI9341_CharGrid::getRunLimit( void )
+{
+	// Row masks for a run take up to half the scratch arena, the rest is the pixel strip
+	size_t size = 0;
+	_target->getScratch(&size);
+	size_t limit = (size/2)/((size_t)_cellHeight*2);
+	return (limit > 0xFF) ? 0xFF : (uint8_t)limit;
+}
+
+ILI9341_STAT_t ILI9341_CharGrid::sendRun( uint8_t row, uint8_t col0, uint8_t col1 )
+{
+	hd_hw_extent_t x = _x0 + ((hd_hw_extent_t)col0*_cellWidth);
+	hd_hw_extent_t y = _y0 + ((hd_hw_extent_t)row*_cellHeight);
+	if((x >= _target->xExt) || (y >= _target->yExt)){ return ILI9341_STAT_Nominal; }
+	hd_hw_extent_t width = (hd_hw_extent_t)((col1 - col0) + 1)*_cellWidth;
+	hd_hw_extent_t height = _cellHeight;
+	if( width > (_target->xExt - x) ){ width = _target->xExt - x; }		// Cells hanging off the panel are cut short
+	if( height > (_target->yExt - y) ){ height = _target->yExt - y; }
+	uint8_t numCells = (uint8_t)((width + (_cellWidth - 1))/_cellWidth);
+
+	// Every cell in the run is expanded once up front, flush() keeps runs short enough for that to fit
+	size_t size = 0;
+	uint8_t* masks = _target->getScratch(&size);
+	size_t maskBytes = (size_t)height*2;
+	if( (size_t)numCells*maskBytes > size/2 ){ return ILI9341_STAT_Error; }
+	uint16_t first = ((uint16_t)row*_cols) + col0;
+	for(uint8_t indi = 0; indi < numCells; indi++){ expandCell(_cells[first + indi], masks + (indi*maskBytes), (uint8_t)height); }
+
+	ILI9341_STAT_t retval = _target->setWindow(x, y, x + (width - 1), y + (height - 1));
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	_target->startRAMWrite();
+
+	// The window is filled row-major, one pixel row across every cell of the run at a time
+	uint8_t* strip = masks + ((size_t)numCells*maskBytes);
+	size -= (size_t)numCells*maskBytes;
+	uint8_t* pend = strip + ((size/_bpp)*_bpp);
+	uint8_t* pdst = strip;
+	for(uint8_t py = 0; py < height; py++)
+	{
+		hd_hw_extent_t px = 0;
+		for(uint8_t indi = 0; indi < numCells; indi++)
+		{
+			const uint8_t* pmask = masks + (indi*maskBytes) + (py*2);
+			uint16_t bits = pmask[0] | (pmask[1] << 8);
+			uint8_t attr = _attrs[first + indi];
+			const uint8_t* fg = _palette + ((attr & 0x0F)*_bpp);
+			const uint8_t* bg = _palette + ((attr >> 4)*_bpp);
+			for(uint8_t col = 0; (col < _cellWidth) && (px < width); col++, px++)
+			{
+				const uint8_t* psrc = (bits & (1 << col)) ? fg : bg;
+				if( _bpp == 2 ){ pdst[0] = psrc[0]; pdst[1] = psrc[1]; }
+				else{ memcpy(pdst, psrc, _bpp); }
+				pdst += _bpp;
+				if( pdst == pend )
+				{
+					retval = _target->continueRAMWrite(strip, (size_t)(pdst - strip));
+					pdst = strip;
+				}
+			}
+		}
+	}
+	if( pdst != strip ){ retval = _target->continueRAMWrite(strip, (size_t)(pdst - strip)); }
+	_target->stopRAMWrite();
+	return retval;
+}
+
+uint16_t ILI9341_CharGrid::flush( void )
+{
+	if((_numDirty == 0) || (_bpp == 0) || (_bpp != _target->getBytesPerPixel())){ return 0; }	// setPalette again after a format change
+
+	uint8_t limit = getRunLimit();
+	if( limit == 0 ){ return 0; }		// Cells too tall for the scratch arena
+
+	uint16_t windows = 0;
+	for(uint8_t row = 0; row < _rows; row++)
+	{
+		uint16_t base = (uint16_t)row*_cols;
+		uint8_t col = 0;
+		while( col < _cols )
+		{
+			if( !isDirty(base + col) ){ col++; continue; }
+			uint8_t start = col;
+			while( (col < _cols) && isDirty(base + col) && ((uint8_t)(col - start) < limit) ){ col++; }
+			sendRun(row, start, col - 1);
+			windows++;
+		}
+	}
+	memset(_dirty, 0x00, sizeof(_dirty));
+	_numDirty = 0;
+	return windows;
+}
@@ -0,0 +1,95 @@
+/*
+
+Character cell (text / tile) mode for HyperDisplay ILI9341 - the
+screen is treated as a grid of fixed size cells, each holding one
+character code and one attribute byte (foreground palette index in
+the low nibble, background in the high nibble). Writes only mark the
+cells whose code or attribute actually changed, and flush() renders
+just those, sending each run of neighbouring dirty cells in a row as
+one window. Each cell in a run is looked up once and its rows are
+expanded into the scratch arena, so a run is cut into several windows
+when their masks would take more than half of it.
+
+Cells are drawn from the display's font through the glyph cache, or
+from a tile set of 1 bit bitmaps for a range of codes. 8x8 cells over
+the whole panel are 30x40 = 1200 cells, so about 2.5 KB including the
+dirty bitmap.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_CHARGRID_H
+#define HPYERDISPLAY_ILI9341_CHARGRID_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_GRID_MAX_CELLS
+#define ILI9341_GRID_MAX_CELLS 1200		// Sizes the dirty bitmap, 8x8 cells over the whole panel
+#endif
+#define ILI9341_GRID_PALETTE 16			// Colors an attribute nibble can pick from
+
+#define ILI9341_GRID_ATTR( fg, bg ) ((uint8_t)(((bg) << 4) | ((fg) & 0x0F)))
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_CharGrid{
+private:
+protected:
+	ILI9341* _target;
+	uint8_t* _cells;
+	uint8_t* _attrs;
+	uint8_t _cols;
+	uint8_t _rows;
+	uint8_t _cellWidth;
+	uint8_t _cellHeight;
+	hd_hw_extent_t _x0;			// Screen position of the top left cell
+	hd_hw_extent_t _y0;
+
+	uint8_t _palette[ILI9341_GRID_PALETTE*ILI9341_MAX_BPP];	// In wire order, ready to copy into the stream
+	uint8_t _bpp;
+
+	const uint8_t* _tiles;		// Bitmaps for codes _firstTile onwards, one row after another
+	uint8_t _firstTile;
+	uint16_t _numTiles;
+
+	uint8_t _dirty[(ILI9341_GRID_MAX_CELLS + 7)/8];
+	uint16_t _numDirty;
+
+	void markDirty( uint16_t cell );
+	bool isDirty( uint16_t cell );
+	void expandCell( uint8_t code, uint8_t* pmask, uint8_t height );		// Looks the glyph or tile up once for all of its rows
+	uint8_t getRunLimit( void );
+	ILI9341_STAT_t sendRun( uint8_t row, uint8_t col0, uint8_t col1 );
+
+public:
+	ILI9341_CharGrid( ILI9341* target, uint8_t* cells, uint8_t* attrs, uint8_t cols, uint8_t rows, uint8_t cellWidth, uint8_t cellHeight );	// cells and attrs hold cols*rows bytes each
+
+	void setOrigin( hd_hw_extent_t x0, hd_hw_extent_t y0 );
+	ILI9341_STAT_t setPalette( color_t colors, uint8_t numColors );		// Copied, call it again after changing the colors or the pixel format
+	void setTiles( const uint8_t* bitmaps, uint8_t firstCode, uint16_t numTiles );	// Bit n of each row byte (or pair of bytes) is column n, NULL goes back to the font
+
+	uint8_t getCols( void );
+	uint8_t getRows( void );
+
+	void putChar( uint8_t col, uint8_t row, uint8_t code, uint8_t attr );
+	uint8_t print( uint8_t col, uint8_t row, const char* str, uint8_t attr );	// Stops at the end of the row, returns the cells written
+	void setAttr( uint8_t col, uint8_t row, uint8_t attr );
+	uint8_t getChar( uint8_t col, uint8_t row );
+	uint8_t getAttr( uint8_t col, uint8_t row );
+	void clear( uint8_t code = ' ', uint8_t attr = 0x00 );
+	void scrollUp( uint8_t attr = 0x00 );			// Moves every row up one, the bottom row is cleared to spaces
+	void invalidate( void );						// Redraw everything on the next flush
+
+	uint16_t getDirtyCount( void );
+	uint16_t flush( void );							// Returns the number of windows sent
+};
+
+#endif /* HPYERDISPLAY_ILI9341_CHARGRID_H */
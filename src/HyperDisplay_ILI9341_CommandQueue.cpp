@@ -0,0 +1,161 @@
+#include "HyperDisplay_ILI9341_CommandQueue.h"
+
+
+ILI9341_CommandQueue::ILI9341_CommandQueue( ILI9341* target )
+{
+	_head = 0;
+	_tail = 0;
+	_target = target;
+	_notify = NULL;
+	_notifyContext = NULL;
+}
+
+void ILI9341_CommandQueue::setNotify( ILI9341_queue_hook_t notify, void* context )
+{
+	_notify = notify;
+	_notifyContext = context;
+}
+
+void ILI9341_CommandQueue::wait( void )
+{
+	if( _notify != NULL ){ _notify(_notifyContext); return; }
+	ILI9341_SPIN_YIELD();			// No hook, let the consumer's thread or task run
+}
+
+uint8_t ILI9341_CommandQueue::getFree( void )
+{
+	uint8_t used = (uint8_t)(_head - ILI9341_LOAD_ACQUIRE(&_tail));
+	return ILI9341_QUEUE_DEPTH - used;
+}
+
+bool ILI9341_CommandQueue::isEmpty( void )
+{
+	return (ILI9341_LOAD_ACQUIRE(&_tail) == ILI9341_LOAD_ACQUIRE(&_head));
+}
+
+
+
+// Producer side
+bool ILI9341_CommandQueue::push( const ILI9341_draw_cmd_t* cmd, bool block )
+{
+	if( cmd == NULL ){ return false; }
+
+	while( getFree() == 0 )
+	{
+		if( !block ){ return false; }
+		wait();						// Backpressure - the consumer has to catch up first
+	}
+
+	_ring[_head & (ILI9341_QUEUE_DEPTH - 1)] = *cmd;
+	ILI9341_STORE_RELEASE(&_head, (uint8_t)(_head + 1));	// Publishes the slot only once it is completely written
+	if( _notify != NULL ){ _notify(_notifyContext); }
+	return true;
+}
+
+bool ILI9341_CommandQueue::pushWindow( ILI9341_QCMD_t type, hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, const uint8_t* src, hd_pixels_t numPixels, color_t color, bool block )
+{
+	ILI9341_draw_cmd_t cmd;
+	cmd.type = type;
+	cmd.x0 = (x0 < x1) ? x0 : x1;
+	cmd.y0 = (y0 < y1) ? y0 : y1;
+	cmd.x1 = (x0 < x1) ? x1 : x0;
+	cmd.y1 = (y0 < y1) ? y1 : y0;
+	cmd.src = src;
+	cmd.stride = 0;
+	cmd.numPixels = numPixels;
+	if( color != NULL ){ memcpy(cmd.color, color, _target->getBytesPerPixel()); }
+
+	// Clipped here rather than in drain() because the clip stack belongs to the producer's side
+	hd_hw_extent_t x0w = cmd.x0;
+	hd_hw_extent_t y0w = cmd.y0;
+	hd_hw_extent_t x1w = cmd.x1;
+	hd_hw_extent_t y1w = cmd.y1;
+	if( !_target->clipWindow(&cmd.x0, &cmd.y0, &cmd.x1, &cmd.y1) ){ return true; }	// Nothing visible, nothing to queue
+	if( type == ILI9341_QCMD_Fill )
+	{
+		cmd.numPixels = (hd_pixels_t)((cmd.x1 - cmd.x0) + 1)*((cmd.y1 - cmd.y0) + 1);
+	}
+	else if( (cmd.x0 != x0w) || (cmd.y0 != y0w) || (cmd.x1 != x1w) )
+	{
+		hd_hw_extent_t width = (x1w - x0w) + 1;
+		hd_pixels_t skip = ((hd_pixels_t)(cmd.y0 - y0w)*width) + (cmd.x0 - x0w);
+		if( skip >= numPixels ){ return true; }
+		cmd.src += (size_t)skip*_target->getBytesPerPixel();
+		cmd.numPixels = numPixels - skip;
+		cmd.stride = width;
+	}
+	else if( cmd.y1 != y1w )
+	{
+		hd_pixels_t area = (hd_pixels_t)((cmd.x1 - cmd.x0) + 1)*((cmd.y1 - cmd.y0) + 1);
+		if( cmd.numPixels > area ){ cmd.numPixels = area; }		// Only the bottom was cut, stop where the window does
+	}
+	return push(&cmd, block);
+}
+
+bool ILI9341_CommandQueue::fill( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t color, bool block )
+{
+	if( color == NULL ){ return false; }
+	hd_pixels_t numPixels = (hd_pixels_t)(((x0 < x1) ? (x1 - x0) : (x0 - x1)) + 1)*(((y0 < y1) ? (y1 - y0) : (y0 - y1)) + 1);
+	return pushWindow(ILI9341_QCMD_Fill, x0, y0, x1, y1, NULL, numPixels, color, block);
+}
+
+bool ILI9341_CommandQueue::fillFromArray( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data, hd_pixels_t numPixels, bool block )
+{
+	if((data == NULL) || (numPixels == 0)){ return false; }
+	return pushWindow(ILI9341_QCMD_Array, x0, y0, x1, y1, (const uint8_t*)data, numPixels, NULL, block);
+}
+
+void ILI9341_CommandQueue::fence( void )
+{
+	while( !isEmpty() )
+	{
+		wait();
+	}
+}
+
+
+
+// Consumer side
+uint8_t ILI9341_CommandQueue::drain( uint8_t maxCommands )
+{
+	uint8_t drawn = 0;
+	uint8_t tail = _tail;
+
+	while( (drawn < maxCommands) && (tail != ILI9341_LOAD_ACQUIRE(&_head)) )
+	{
+		ILI9341_draw_cmd_t* cmd = &_ring[tail & (ILI9341_QUEUE_DEPTH - 1)];
+
+		_target->setWindow(cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+		_target->startRAMWrite();
+		if( cmd->type == ILI9341_QCMD_Fill )
+		{
+			_target->streamColorCycle((color_t)cmd->color, cmd->numPixels);
+		}
+		else if( cmd->stride == 0 )
+		{
+			_target->continuePixelWrite((const uint8_t*)cmd->src, cmd->numPixels);
+		}
+		else
+		{
+			// A clipped array - one row of the window at a time, stepping over the source pixels that were cut off
+			hd_hw_extent_t width = (cmd->x1 - cmd->x0) + 1;
+			size_t rowBytes = (size_t)cmd->stride*_target->getBytesPerPixel();
+			const uint8_t* psrc = cmd->src;
+			hd_pixels_t left = cmd->numPixels;
+			for(hd_hw_extent_t y = cmd->y0; (y <= cmd->y1) && (left != 0); y++)
+			{
+				hd_pixels_t count = (left > width) ? width : left;
+				_target->continuePixelWrite(psrc, count);
+				psrc += rowBytes;
+				left = (left > cmd->stride) ? (left - cmd->stride) : 0;
+			}
+		}
+		_target->stopRAMWrite();
+
+		// Only hand the slot back once it has been drawn, so that fence() also means the arrays are free
+		tail++;
+		ILI9341_STORE_RELEASE(&_tail, tail);
+		drawn++;
+	}
+	return drawn;
+}
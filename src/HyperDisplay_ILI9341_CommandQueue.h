@@ -0,0 +1,107 @@
+/*
+
+Draw command queue for HyperDisplay ILI9341 - a lock-free single 
+producer / single consumer ring. The application encodes windowed 
+draws (a window plus a fill color or pixel array) without touching
+the bus, and an ISR, DMA-complete handler or second core drains the
+ring into the display.
+
+Only the consumer may talk to the display while the queue is in use.
+
+fill() and fillFromArray() are trimmed to the display's clip stack as
+they are pushed, on the producer side where the clips are set, so a
+clipped array is sent row by row from the middle of the caller's
+pixels. Commands handed to push() directly are drawn as they are.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_COMMANDQUEUE_H
+#define HPYERDISPLAY_ILI9341_COMMANDQUEUE_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_QUEUE_DEPTH
+#define ILI9341_QUEUE_DEPTH 16		// Must be a power of two, no more than 128
+#endif
+#if ((ILI9341_QUEUE_DEPTH & (ILI9341_QUEUE_DEPTH - 1)) != 0) || (ILI9341_QUEUE_DEPTH > 128)
+#error "ILI9341_QUEUE_DEPTH must be a power of two no larger than 128"
+#endif
+
+// Indices are single bytes so loads and stores are atomic on every core, these add the ordering
+#define ILI9341_LOAD_ACQUIRE(p) 	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ILI9341_STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// Busy waits give the other side a chance to run - another thread on hosts, the core's background tasks on MCUs
+#if defined(ARDUINO)
+#define ILI9341_SPIN_YIELD()		yield()
+#else
+#include <thread>
+#define ILI9341_SPIN_YIELD()		std::this_thread::yield()
+#endif
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef enum{
+	ILI9341_QCMD_Fill = 0x00,		// Fill the window with one color
+	ILI9341_QCMD_Array				// Fill the window from a pixel array, which must stay valid until it has been drained
+}ILI9341_QCMD_t;
+
+typedef struct ILI9341_draw_cmd{
+	ILI9341_QCMD_t type;
+	hd_hw_extent_t x0;
+	hd_hw_extent_t y0;
+	hd_hw_extent_t x1;
+	hd_hw_extent_t y1;
+	const uint8_t* src;				// Pixel source for ILI9341_QCMD_Array
+	hd_hw_extent_t stride;			// Source pixels per row when that is wider than the window (the array was clipped), 0 otherwise
+	hd_pixels_t numPixels;
+	uint8_t color[ILI9341_MAX_BPP];	// Fill color for ILI9341_QCMD_Fill, copied so the caller's color can change right away
+}ILI9341_draw_cmd_t;
+
+typedef void (*ILI9341_queue_hook_t)(void* context);
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_CommandQueue{
+private:
+protected:
+	ILI9341_draw_cmd_t _ring[ILI9341_QUEUE_DEPTH];
+	uint8_t _head;					// Free-running, written only by the producer
+	uint8_t _tail;					// Free-running, written only by the consumer
+	ILI9341* _target;
+
+	ILI9341_queue_hook_t _notify;	// Called after each push and while the producer waits
+	void* _notifyContext;
+
+	void wait( void );
+	bool pushWindow( ILI9341_QCMD_t type, hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, const uint8_t* src, hd_pixels_t numPixels, color_t color, bool block );
+
+public:
+	ILI9341_CommandQueue( ILI9341* target );
+
+	void setNotify( ILI9341_queue_hook_t notify, void* context );	// e.g. pend an interrupt, signal the other core or yield to the RTOS
+
+	// Producer side
+	bool push( const ILI9341_draw_cmd_t* cmd, bool block = false );		// Returns false when the ring is full and block is false
+	bool fill( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t color, bool block = true );
+	bool fillFromArray( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data, hd_pixels_t numPixels, bool block = true );
+	void fence( void );												// Returns once everything pushed so far has been drawn
+	uint8_t getFree( void );
+	bool isEmpty( void );
+
+	// Consumer side
+	uint8_t drain( uint8_t maxCommands = ILI9341_QUEUE_DEPTH );		// Returns how many commands were drawn
+};
+
+#endif /* HPYERDISPLAY_ILI9341_COMMANDQUEUE_H */
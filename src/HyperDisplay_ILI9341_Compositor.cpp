@@ -0,0 +1,267 @@
+#include "HyperDisplay_ILI9341_Compositor.h"
+
+
+ILI9341_Compositor::ILI9341_Compositor( ILI9341* target, uint8_t* stage, uint8_t* alpha, hd_pixels_t pixels )
+{
+	_target = target;
+	_stage = stage;
+	_alpha = alpha;
+	_stagePixels = (stage == NULL) ? 0 : pixels;
+	_numLayers = 0;
+}
+
+int8_t ILI9341_Compositor::addLayer( ILI9341_band_render_t render, ILI9341_layer_render_t renderAlpha, void* context, uint8_t alpha )
+{
+	if( _numLayers >= ILI9341_COMPOSITOR_MAX_LAYERS ){ return -1; }
+
+	ILI9341_layer_t* layer = &_layers[_numLayers];
+	layer->render = render;
+	layer->renderAlpha = renderAlpha;
+	layer->context = context;
+	layer->alpha = alpha;
+	layer->visible = true;
+	return (int8_t)(_numLayers++);
+}
+
+int8_t ILI9341_Compositor::addLayer( ILI9341_band_render_t render, void* context, uint8_t alpha )
+{
+	if( render == NULL ){ return -1; }
+	return addLayer(render, NULL, context, alpha);
+}
+
+int8_t ILI9341_Compositor::addLayer( ILI9341_layer_render_t render, void* context, uint8_t alpha )
+{
+	if((render == NULL) || (_alpha == NULL)){ return -1; }
+	return addLayer(NULL, render, context, alpha);
+}
+
+uint8_t ILI9341_Compositor::getNumLayers( void )
+{
+	return _numLayers;
+}
+
+void ILI9341_Compositor::removeLayers( void )
+{
+	_numLayers = 0;
+}
+
+void ILI9341_Compositor::setLayerAlpha( uint8_t layer, uint8_t alpha )
+{
+	if( layer < _numLayers ){ _layers[layer].alpha = alpha; }
+}
+
+uint8_t ILI9341_Compositor::getLayerAlpha( uint8_t layer )
+{
+	if( layer >= _numLayers ){ return ILI9341_ALPHA_CLEAR; }
+	return _layers[layer].alpha;
+}
+
+void ILI9341_Compositor::setLayerVisible( uint8_t layer, bool visible )
+{
+	if( layer < _numLayers ){ _layers[layer].visible = visible; }
+}
+
+
+
+// Blending kernels
+#if !ILI9341_BLEND_SPLIT565
+// Plain per-channel mixes with no early-outs - alpha 0 and 256 already come out exact - so each loop is straight-line code the vectorizer takes
+static inline uint16_t ILI9341_mix565( uint16_t s, uint16_t d, uint16_t a )
+{
+	uint16_t r = ((((s >> 11) & 0x1F)*a) + (((d >> 11) & 0x1F)*(256 - a))) >> 8;
+	uint16_t g = ((((s >> 5) & 0x3F)*a) + (((d >> 5) & 0x3F)*(256 - a))) >> 8;
+	uint16_t b = (((s & 0x1F)*a) + ((d & 0x1F)*(256 - a))) >> 8;
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static inline uint16_t ILI9341_pixelAlpha( uint8_t alpha, uint16_t la )
+{
+	uint16_t a = (uint16_t)((alpha*la) >> 8);
+	return a + (a >> 7);
+}
+
+typedef uint16_t ILI9341_pixel565_t __attribute__((aligned(1), may_alias));	// Bands have no alignment guarantee
+
+static inline uint16_t ILI9341_swap16( uint16_t v )
+{
+	return (uint16_t)((v >> 8) | (v << 8));
+}
+
+// One loop per alpha source and byte order, so each is straight-line 16 bit lanes (wire order is swapped in and out on little endian hosts)
+static void ILI9341_blend565Loop( ILI9341_pixel565_t* __restrict dst, const ILI9341_pixel565_t* __restrict src, const uint8_t* __restrict alpha, uint16_t la, hd_pixels_t numPixels, bool swap )
+{
+	if( swap )
+	{
+		if( alpha == NULL ){ for(hd_pixels_t indi = 0; indi < numPixels; indi++){ dst[indi] = ILI9341_swap16(ILI9341_mix565(ILI9341_swap16(src[indi]), ILI9341_swap16(dst[indi]), la)); } }
+		else{ for(hd_pixels_t indi = 0; indi < numPixels; indi++){ dst[indi] = ILI9341_swap16(ILI9341_mix565(ILI9341_swap16(src[indi]), ILI9341_swap16(dst[indi]), ILI9341_pixelAlpha(alpha[indi], la))); } }
+		return;
+	}
+	if( alpha == NULL ){ for(hd_pixels_t indi = 0; indi < numPixels; indi++){ dst[indi] = ILI9341_mix565(src[indi], dst[indi], la); } }
+	else{ for(hd_pixels_t indi = 0; indi < numPixels; indi++){ dst[indi] = ILI9341_mix565(src[indi], dst[indi], ILI9341_pixelAlpha(alpha[indi], la)); } }
+}
+#endif
+
+void ILI9341_Compositor::blend565( uint8_t* dst, const uint8_t* src, const uint8_t* alpha, uint8_t layerAlpha, hd_pixels_t numPixels, bool native )
+{
+	uint16_t la = (uint16_t)layerAlpha + (layerAlpha >> 7);		// 0 to 256
+	if( alpha == NULL )
+	{
+		// A constant alpha at either end needs no arithmetic at all
+		if( la == 0 ){ return; }
+		if( la >= 256 ){ memcpy(dst, src, (size_t)numPixels*2); return; }
+	}
+#if ILI9341_BLEND_SPLIT565
+	for(hd_pixels_t indi = 0; indi < numPixels; indi++)
+	{
+		uint16_t a = la;
+		if( alpha != NULL )
+		{
+			a = (uint16_t)((alpha[indi]*la) >> 8);
+			a += (a >> 7);
+		}
+		const uint8_t* ps = src + (indi << 1);
+		uint8_t* pd = dst + (indi << 1);
+		if( a == 0 ){ continue; }
+		if( a >= 256 ){ pd[0] = ps[0]; pd[1] = ps[1]; continue; }
+
+		uint16_t s, d;
+		if( native )
+		{
+			memcpy(&s, ps, sizeof(s));
+			memcpy(&d, pd, sizeof(d));
+		}
+		else
+		{
+			s = ((uint16_t)ps[0] << 8) | ps[1];		// Pixels are kept in wire order
+			d = ((uint16_t)pd[0] << 8) | pd[1];
+		}
+		// Spread the channels out as -gggggg-----rrrrr------bbbbb so one multiply blends all three
+		uint32_t a5 = (a + 4) >> 3;
+		uint32_t S = (s | ((uint32_t)s << 16)) & 0x07E0F81FUL;
+		uint32_t D = (d | ((uint32_t)d << 16)) & 0x07E0F81FUL;
+		uint32_t R = (((S*a5) + (D*(32 - a5))) >> 5) & 0x07E0F81FUL;
+		uint16_t out = (uint16_t)(R | (R >> 16));
+		if( native ){ memcpy(pd, &out, sizeof(out)); continue; }
+		pd[0] = (uint8_t)(out >> 8);
+		pd[1] = (uint8_t)(out);
+	}
+#else
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	bool swap = false;			// Wire order is already native
+#else
+	bool swap = !native;
+#endif
+	ILI9341_blend565Loop((ILI9341_pixel565_t*)dst, (const ILI9341_pixel565_t*)src, alpha, la, numPixels, swap);
+#endif
+}
+
+void ILI9341_Compositor::blend666( uint8_t* dst, const uint8_t* src, const uint8_t* alpha, uint8_t layerAlpha, hd_pixels_t numPixels )
+{
+	uint16_t la = (uint16_t)layerAlpha + (layerAlpha >> 7);
+	for(hd_pixels_t indi = 0; indi < numPixels; indi++)
+	{
+		uint16_t a = la;
+		if( alpha != NULL )
+		{
+			a = (uint16_t)((alpha[indi]*la) >> 8);
+			a += (a >> 7);
+		}
+		if( a == 0 ){ continue; }
+		for(uint8_t chan = 0; chan < 3; chan++)
+		{
+			uint8_t* pd = dst + (indi*3) + chan;
+			*pd = (uint8_t)((((uint16_t)src[(indi*3) + chan]*a) + ((uint16_t)*pd*(256 - a))) >> 8) & 0xFC;
+		}
+	}
+}
+
+
+
+// Rasterizing
+bool ILI9341_Compositor::canCompose( hd_hw_extent_t width )
+{
+	// Upper layers are staged at least a whole row at a time
+	return (_numLayers <= 1) || (_stagePixels >= width);
+}
+
+void ILI9341_Compositor::compose( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, uint8_t bpp )
+{
+	hd_pixels_t numPixels = (hd_pixels_t)width*rows;
+	bool base = true;
+	for(uint8_t indi = 0; indi < _numLayers; indi++)
+	{
+		ILI9341_layer_t* layer = &_layers[indi];
+		if( !layer->visible ){ continue; }
+		if( base )
+		{
+			// Whatever is at the bottom is opaque, there is nothing below it to blend with
+			if( layer->render != NULL ){ layer->render(band, y0, rows, width, layer->context); }
+			else{ layer->renderAlpha(band, _alpha, y0, rows, width, layer->context); }
+			base = false;
+			continue;
+		}
+		if( layer->alpha == ILI9341_ALPHA_CLEAR ){ continue; }
+
+		const uint8_t* alpha = NULL;
+		if( layer->render != NULL )
+		{
+			layer->render(_stage, y0, rows, width, layer->context);
+		}
+		else
+		{
+			layer->renderAlpha(_stage, _alpha, y0, rows, width, layer->context);
+			alpha = _alpha;
+		}
+
+		if( bpp == 2 ){ blend565(band, _stage, alpha, layer->alpha, numPixels, _target->getNativeEndian()); }
+		else{ blend666(band, _stage, alpha, layer->alpha, numPixels); }
+	}
+}
+
+void ILI9341_Compositor::renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	if((band == NULL) || (width == 0) || (bpp == 0)){ return; }
+
+	if( !canCompose(width) ){ return; }
+
+	// The staging band may be smaller than the outgoing one, in that case compose it a few rows at a time
+	hd_hw_extent_t step = (hd_hw_extent_t)(_stagePixels/width);
+	if( step == 0 ){ step = rows; }		// Only one layer, the stage is never touched
+	for(hd_hw_extent_t row = 0; row < rows; row += step)
+	{
+		hd_hw_extent_t count = ((rows - row) < step) ? (rows - row) : step;
+		compose(band + ((size_t)row*width*bpp), y0 + row, count, width, bpp);
+	}
+}
+
+void ILI9341_Compositor::renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, void* context )
+{
+	if( context == NULL ){ return; }
+	((ILI9341_Compositor*)context)->renderBand(band, y0, rows, width);
+}
+
+ILI9341_STAT_t ILI9341_Compositor::render( uint8_t* buff, size_t size, ILI9341_FrameDiff* diff )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	hd_hw_extent_t width = _target->xExt;
+	hd_hw_extent_t height = _target->yExt;
+	if((buff == NULL) || (bpp == 0)){ return ILI9341_STAT_Error; }
+
+	hd_hw_extent_t rowsPerBand = size/((size_t)width*bpp);
+	if( rowsPerBand == 0 ){ return ILI9341_STAT_Error; }
+	if( !canCompose(width) ){ return ILI9341_STAT_Error; }
+
+	for(hd_hw_extent_t y0 = 0; y0 < height; y0 += rowsPerBand)
+	{
+		hd_hw_extent_t rows = ((height - y0) < rowsPerBand) ? (height - y0) : rowsPerBand;
+		renderBand(buff, y0, rows, width);
+		if( diff != NULL )
+		{
+			diff->sendBand(buff, y0, rows, width);
+			continue;
+		}
+		_target->hwfillFromArray(0, y0, width - 1, y0 + (rows - 1), (color_t)buff, (hd_pixels_t)width*rows);
+	}
+	return ILI9341_STAT_Nominal;
+}
@@ -0,0 +1,100 @@
+/*
+
+Layered alpha compositor for HyperDisplay ILI9341 - stacks several
+band renderers (background, widgets, overlay...) and blends them 
+together band by band on the way to hwfillFromArray, so translucent
+pop-ups and fades work without ever reading GRAM back.
+
+The bottom layer renders straight into the outgoing band. Every layer
+above it renders into a staging band and is blended on top with its
+layer alpha, multiplied by a per-pixel alpha plane when the layer 
+provides one. 16 bit pixels use the 565 split-multiply trick on MCUs
+(all three channels in one 32 bit multiply) and branch-free per-channel
+loops on hosts, one per alpha source and byte order, which GCC -O3 
+vectorizes. 18 bit pixels are blended per channel.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_COMPOSITOR_H
+#define HPYERDISPLAY_ILI9341_COMPOSITOR_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+#include "HyperDisplay_ILI9341_BandPipeline.h"		// For ILI9341_band_render_t
+#include "HyperDisplay_ILI9341_FrameDiff.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_COMPOSITOR_MAX_LAYERS
+#define ILI9341_COMPOSITOR_MAX_LAYERS 4
+#endif
+
+#ifndef ILI9341_BLEND_SPLIT565
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define ILI9341_BLEND_SPLIT565 0		// Hosts - the per-channel loops vectorize
+#else
+#define ILI9341_BLEND_SPLIT565 1		// MCUs - one multiply per pixel
+#endif
+#endif
+
+#define ILI9341_ALPHA_OPAQUE 255
+#define ILI9341_ALPHA_CLEAR 0
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef void (*ILI9341_layer_render_t)(uint8_t* band, uint8_t* alpha, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, void* context);	// Like ILI9341_band_render_t plus one alpha byte per pixel
+
+typedef struct ILI9341_layer{
+	ILI9341_band_render_t render;			// Exactly one of render and renderAlpha is set
+	ILI9341_layer_render_t renderAlpha;
+	void* context;
+	uint8_t alpha;							// Whole layer, ILI9341_ALPHA_CLEAR to ILI9341_ALPHA_OPAQUE
+	bool visible;
+}ILI9341_layer_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_Compositor{
+private:
+protected:
+	ILI9341* _target;
+	ILI9341_layer_t _layers[ILI9341_COMPOSITOR_MAX_LAYERS];
+	uint8_t _numLayers;
+	uint8_t* _stage;				// Staging band for the upper layers
+	uint8_t* _alpha;				// Per-pixel alpha for the staging band, may be NULL
+	hd_pixels_t _stagePixels;
+
+	int8_t addLayer( ILI9341_band_render_t render, ILI9341_layer_render_t renderAlpha, void* context, uint8_t alpha );
+	bool canCompose( hd_hw_extent_t width );		// False when upper layers need a stage that can't hold a row
+	void compose( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, uint8_t bpp );
+
+public:
+	ILI9341_Compositor( ILI9341* target, uint8_t* stage, uint8_t* alpha, hd_pixels_t pixels );	// stage holds pixels pixels in the display's format, alpha holds pixels bytes (or NULL when no layer has per-pixel alpha)
+
+	int8_t addLayer( ILI9341_band_render_t render, void* context, uint8_t alpha = ILI9341_ALPHA_OPAQUE );		// Returns the layer index or -1, layers stack in the order they are added
+	int8_t addLayer( ILI9341_layer_render_t render, void* context, uint8_t alpha = ILI9341_ALPHA_OPAQUE );
+	uint8_t getNumLayers( void );
+	void removeLayers( void );
+	void setLayerAlpha( uint8_t layer, uint8_t alpha );
+	uint8_t getLayerAlpha( uint8_t layer );
+	void setLayerVisible( uint8_t layer, bool visible );
+
+	// Rasterizing, same shape as ILI9341_Scene so compositors can feed a pipeline or a frame diff
+	void renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width );	// Leaves the band alone if the stage is too small for the layers
+	static void renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, void* context );
+	ILI9341_STAT_t render( uint8_t* buff, size_t size, ILI9341_FrameDiff* diff = NULL );
+
+	// Blending kernels - dst = src over dst with alpha scaled by layerAlpha, alpha may be NULL
+	static void blend565( uint8_t* dst, const uint8_t* src, const uint8_t* alpha, uint8_t layerAlpha, hd_pixels_t numPixels, bool native = false );	// native when the bands hold uint16_t pixels
+	static void blend666( uint8_t* dst, const uint8_t* src, const uint8_t* alpha, uint8_t layerAlpha, hd_pixels_t numPixels );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_COMPOSITOR_H */
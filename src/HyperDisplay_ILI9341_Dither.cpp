@@ -0,0 +1,219 @@
+#include "HyperDisplay_ILI9341_Dither.h"
+
+
+static const uint8_t ILI9341_bayer4[16] = {
+	 0,  8,  2, 10,
+	12,  4, 14,  6,
+	 3, 11,  1,  9,
+	15,  7, 13,  5
+};
+
+static const uint8_t ILI9341_bayer8[64] = {
+	 0, 32,  8, 40,  2, 34, 10, 42,
+	48, 16, 56, 24, 50, 18, 58, 26,
+	12, 44,  4, 36, 14, 46,  6, 38,
+	60, 28, 52, 20, 62, 30, 54, 22,
+	 3, 35, 11, 43,  1, 33,  9, 41,
+	51, 19, 59, 27, 49, 17, 57, 25,
+	15, 47,  7, 39, 13, 45,  5, 37,
+	63, 31, 55, 23, 61, 29, 53, 21
+};
+
+static const uint8_t ILI9341_bayerNone[1] = { 0 };
+
+ILI9341_Dither::ILI9341_Dither( ILI9341* target, ILI9341_DITHER_t matrix )
+{
+	_target = target;
+	_matrix = matrix;
+}
+
+void ILI9341_Dither::setMatrix( ILI9341_DITHER_t matrix )
+{
+	_matrix = matrix;
+}
+
+ILI9341_DITHER_t ILI9341_Dither::getMatrix( void )
+{
+	return _matrix;
+}
+
+const uint8_t* ILI9341_Dither::getMatrixRow( ILI9341_DITHER_t matrix, hd_hw_extent_t y, uint8_t* colMask, uint8_t* shift )
+{
+	// shift brings a matrix entry down to the 0 to 7 range used for 5 bit channels, one more gives 0 to 3 for 6 bit channels
+	switch( matrix )
+	{
+		case ILI9341_DITHER_Bayer4 :
+			*colMask = 0x03;
+			*shift = 1;
+			return &ILI9341_bayer4[(y & 0x03)*4];
+
+		case ILI9341_DITHER_Bayer8 :
+			*colMask = 0x07;
+			*shift = 3;
+			return &ILI9341_bayer8[(y & 0x07)*8];
+
+		default :
+			break;
+	}
+	*colMask = 0x00;
+	*shift = 0;
+	return ILI9341_bayerNone;
+}
+
+#if ILI9341_DITHER_TILED
+#if defined(__x86_64__) && !defined(__SSSE3__) && defined(__linux__) && defined(__GNUC__) && !defined(__clang__)
+#define ILI9341_DITHER_CLONES __attribute__((target_clones("ssse3", "default")))		// Baseline SSE2 can't gather every third byte
+#else
+#define ILI9341_DITHER_CLONES
+#endif
+
+static inline uint8_t ILI9341_addSat( uint8_t a, uint8_t b )
+{
+	uint16_t val = (uint16_t)a + b;
+	return (val > 0xFF) ? 0xFF : (uint8_t)val;
+}
+
+static void ILI9341_ditherBias( uint8_t* __restrict dst, const uint8_t* __restrict src, const uint8_t* __restrict bias, uint16_t numBytes )
+{
+	for(uint16_t indi = 0; indi < numBytes; indi++){ dst[indi] = ILI9341_addSat(src[indi], bias[indi]); }
+}
+
+static void ILI9341_ditherBias666( uint8_t* __restrict dst, const uint8_t* __restrict src, const uint8_t* __restrict bias, uint16_t numBytes )
+{
+	for(uint16_t indi = 0; indi < numBytes; indi++){ dst[indi] = ILI9341_addSat(src[indi], bias[indi]) & 0xFC; }
+}
+
+ILI9341_DITHER_CLONES static void ILI9341_pack565( uint8_t* __restrict dst, const uint8_t* __restrict rgb, uint16_t numPixels )
+{
+	for(uint16_t indi = 0; indi < numPixels; indi++)
+	{
+		uint8_t r = rgb[(3*indi)];
+		uint8_t g = rgb[(3*indi) + 1];
+		uint8_t b = rgb[(3*indi) + 2];
+		dst[(2*indi)] = (r & 0xF8) | (g >> 5);
+		dst[(2*indi) + 1] = ((g << 3) & 0xE0) | (b >> 3);
+	}
+}
+#endif
+
+void ILI9341_Dither::convert565( uint8_t* pdst, const uint8_t* prgb, hd_pixels_t numPixels, hd_hw_extent_t x, hd_hw_extent_t y, ILI9341_DITHER_t matrix )
+{
+	uint8_t colMask, shift;
+	const uint8_t* prow = getMatrixRow(matrix, y, &colMask, &shift);
+#if ILI9341_DITHER_TILED
+	// Tiles are a whole number of matrix widths, so one bias table lines up with all of them
+	uint8_t bias[ILI9341_DITHER_TILE*3];
+	uint8_t biased[ILI9341_DITHER_TILE*3];
+	for(uint8_t indi = 0; indi < ILI9341_DITHER_TILE; indi++)
+	{
+		uint8_t bias5 = prow[(x + indi) & colMask] >> shift;
+		bias[(3*indi)] = bias5;
+		bias[(3*indi) + 1] = bias5 >> 1;
+		bias[(3*indi) + 2] = bias5;
+	}
+	while( numPixels != 0 )
+	{
+		uint16_t count = (numPixels > ILI9341_DITHER_TILE) ? ILI9341_DITHER_TILE : (uint16_t)numPixels;
+		ILI9341_ditherBias(biased, prgb, bias, count*3);
+		ILI9341_pack565(pdst, biased, count);
+		pdst += count*2;
+		prgb += count*3;
+		numPixels -= count;
+	}
+#else
+	for(hd_pixels_t indi = 0; indi < numPixels; indi++)
+	{
+		uint8_t cell = prow[(x + indi) & colMask];
+		uint8_t bias5 = cell >> shift;
+		uint8_t bias6 = bias5 >> 1;
+		uint16_t r = (uint16_t)prgb[0] + bias5;
+		uint16_t g = (uint16_t)prgb[1] + bias6;
+		uint16_t b = (uint16_t)prgb[2] + bias5;
+		if( r > 0xFF ){ r = 0xFF; }
+		if( g > 0xFF ){ g = 0xFF; }
+		if( b > 0xFF ){ b = 0xFF; }
+		pdst[0] = (r & 0xF8) | (g >> 5);
+		pdst[1] = ((g << 3) & 0xE0) | (b >> 3);
+		pdst += 2;
+		prgb += 3;
+	}
+#endif
+}
+
+void ILI9341_Dither::convert666( uint8_t* pdst, const uint8_t* prgb, hd_pixels_t numPixels, hd_hw_extent_t x, hd_hw_extent_t y, ILI9341_DITHER_t matrix )
+{
+	uint8_t colMask, shift;
+	const uint8_t* prow = getMatrixRow(matrix, y, &colMask, &shift);
+#if ILI9341_DITHER_TILED
+	// Input and output are both three bytes a pixel, so the add, saturate and mask is a single pass
+	uint8_t bias[ILI9341_DITHER_TILE*3];
+	for(uint8_t indi = 0; indi < ILI9341_DITHER_TILE; indi++)
+	{
+		uint8_t bias6 = prow[(x + indi) & colMask] >> (shift + 1);
+		bias[(3*indi)] = bias6;
+		bias[(3*indi) + 1] = bias6;
+		bias[(3*indi) + 2] = bias6;
+	}
+	while( numPixels != 0 )
+	{
+		uint16_t count = (numPixels > ILI9341_DITHER_TILE) ? ILI9341_DITHER_TILE : (uint16_t)numPixels;
+		ILI9341_ditherBias666(pdst, prgb, bias, count*3);
+		pdst += count*3;
+		prgb += count*3;
+		numPixels -= count;
+	}
+#else
+	for(hd_pixels_t indi = 0; indi < numPixels; indi++)
+	{
+		uint8_t bias6 = prow[(x + indi) & colMask] >> (shift + 1);
+		for(uint8_t chan = 0; chan < 3; chan++)
+		{
+			uint16_t val = (uint16_t)prgb[chan] + bias6;
+			pdst[chan] = (val > 0xFF) ? 0xFC : (val & 0xFC);
+		}
+		pdst += 3;
+		prgb += 3;
+	}
+#endif
+}
+
+void ILI9341_Dither::convertRow( uint8_t* pdst, const uint8_t* prgb, hd_pixels_t numPixels, hd_hw_extent_t x, hd_hw_extent_t y )
+{
+	if( _target->getBytesPerPixel() != 2 ){ convert666(pdst, prgb, numPixels, x, y, _matrix); return; }
+	convert565(pdst, prgb, numPixels, x, y, _matrix);
+	if( _target->getNativeEndian() ){ ILI9341::swap565(pdst, numPixels); }		// Rows handed back to the application match its pixel order
+}
+
+ILI9341_STAT_t ILI9341_Dither::fillFromRGB888( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, const uint8_t* prgb )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	if((prgb == NULL) || (bpp == 0)){ return ILI9341_STAT_Error; }
+	if( x1 < x0 ){ hd_hw_extent_t temp = x0; x0 = x1; x1 = temp; }
+	if( y1 < y0 ){ hd_hw_extent_t temp = y0; y0 = y1; y1 = temp; }
+
+	size_t size = 0;
+	uint8_t* scratch = _target->getScratch(&size);
+	hd_pixels_t chunkPixels = size/bpp;
+	if( chunkPixels == 0 ){ return ILI9341_STAT_Error; }
+	hd_hw_extent_t width = (x1 - x0) + 1;
+
+	ILI9341_STAT_t retval = _target->setWindow(x0, y0, x1, y1);
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	_target->startRAMWrite();
+	for(hd_hw_extent_t y = y0; y <= y1; y++)
+	{
+		for(hd_hw_extent_t dx = 0; dx < width; )
+		{
+			hd_pixels_t count = ((hd_pixels_t)(width - dx) > chunkPixels) ? chunkPixels : (width - dx);
+			if( bpp == 2 ){ convert565(scratch, prgb, count, x0 + dx, y, _matrix); }	// Straight to the bus so always wire order
+			else{ convert666(scratch, prgb, count, x0 + dx, y, _matrix); }
+			retval = _target->continueRAMWrite(scratch, (size_t)count*bpp);
+			if( retval != ILI9341_STAT_Nominal ){ break; }
+			prgb += count*3;
+			dx += count;
+		}
+		if( retval != ILI9341_STAT_Nominal ){ break; }
+	}
+	_target->stopRAMWrite();
+	return retval;
+}
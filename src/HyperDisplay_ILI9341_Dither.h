@@ -0,0 +1,77 @@
+/*
+
+Ordered dithering for HyperDisplay ILI9341 - converts 24 bit RGB to 
+the display's 565 or 666 format with a 4x4 or 8x8 Bayer matrix
+instead of just dropping the low bits, which takes the banding out of
+gradients. The matrix is indexed by screen coordinate, not by
+position in the source, so partial updates, tiles and bands all line
+up with each other.
+
+On MCUs the offsets come straight from the matrix tables so a pixel
+costs a lookup, a shift, an add and a saturate per channel. Hosts
+expand the row's offsets once into a bias table and then run
+straight-line passes over tiles of pixels - a saturating add of the
+bias, then the 565 packing - which GCC -O3 vectorizes. The packing
+needs byte shuffles, so plain x86-64 builds also get an SSSE3 copy
+picked at run time.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_DITHER_H
+#define HPYERDISPLAY_ILI9341_DITHER_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_DITHER_TILED
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+#define ILI9341_DITHER_TILED 1			// Hosts - bias table and separate passes that vectorize
+#else
+#define ILI9341_DITHER_TILED 0			// MCUs - one table lookup per pixel
+#endif
+#endif
+#define ILI9341_DITHER_TILE 64			// Pixels per pass on hosts, a multiple of every matrix width
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef enum{
+	ILI9341_DITHER_None = 0x00,			// Plain truncation, same as rgbTo16b
+	ILI9341_DITHER_Bayer4,
+	ILI9341_DITHER_Bayer8
+}ILI9341_DITHER_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_Dither{
+private:
+protected:
+	ILI9341* _target;
+	ILI9341_DITHER_t _matrix;
+
+	static const uint8_t* getMatrixRow( ILI9341_DITHER_t matrix, hd_hw_extent_t y, uint8_t* colMask, uint8_t* shift );
+
+public:
+	ILI9341_Dither( ILI9341* target, ILI9341_DITHER_t matrix = ILI9341_DITHER_Bayer4 );
+
+	void setMatrix( ILI9341_DITHER_t matrix );
+	ILI9341_DITHER_t getMatrix( void );
+
+	// Kernels - convert numPixels of packed r,g,b bytes whose first pixel lands on screen at (x, y)
+	static void convert565( uint8_t* pdst, const uint8_t* prgb, hd_pixels_t numPixels, hd_hw_extent_t x, hd_hw_extent_t y, ILI9341_DITHER_t matrix );
+	static void convert666( uint8_t* pdst, const uint8_t* prgb, hd_pixels_t numPixels, hd_hw_extent_t x, hd_hw_extent_t y, ILI9341_DITHER_t matrix );
+	void convertRow( uint8_t* pdst, const uint8_t* prgb, hd_pixels_t numPixels, hd_hw_extent_t x, hd_hw_extent_t y );	// In the target's current pixel format
+
+	// Flush stage - streams a block of 24 bit pixels into a window, converting through the scratch arena on the way
+	ILI9341_STAT_t fillFromRGB888( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, const uint8_t* prgb );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_DITHER_H */
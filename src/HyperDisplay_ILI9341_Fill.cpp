@@ -0,0 +1,309 @@
+#include "HyperDisplay_ILI9341_Fill.h"
+
+
+ILI9341_Fill::ILI9341_Fill( ILI9341* target )
+{
+	_target = target;
+	_colorSet = false;
+	_windows = 0;
+	_numPending = 0;
+	_row = 0;
+}
+
+ILI9341_STAT_t ILI9341_Fill::setColor( color_t color )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	if((color == NULL) || (bpp == 0)){ return ILI9341_STAT_Error; }
+	memcpy(_color, color, bpp);		// Kept in the caller's order, hwrectangle takes care of the rest
+	_colorSet = true;
+	return ILI9341_STAT_Nominal;
+}
+
+uint32_t ILI9341_Fill::getWindowCount( void )
+{
+	return _windows;
+}
+
+void ILI9341_Fill::resetWindowCount( void )
+{
+	_windows = 0;
+}
+
+
+
+// Span merging
+void ILI9341_Fill::sendRect( int16_t x0, int16_t y0, int16_t x1, int16_t y1 )
+{
+	if( x0 < 0 ){ x0 = 0; }
+	if( y0 < 0 ){ y0 = 0; }
+	if( x1 >= (int16_t)_target->xExt ){ x1 = _target->xExt - 1; }
+	if( y1 >= (int16_t)_target->yExt ){ y1 = _target->yExt - 1; }
+	if((x0 > x1) || (y0 > y1)){ return; }
+	_target->hwrectangle(x0, y0, x1, y1, true, (color_t)_color);	// Also applies the clip stack
+	_windows++;
+}
+
+void ILI9341_Fill::begin( void )
+{
+	_numPending = 0;
+	_target->startBatch();
+}
+
+void ILI9341_Fill::addSpans( int16_t y, const int16_t* x0, const int16_t* x1, uint8_t numSpans )
+{
+	if((_numPending != 0) && (y != _row))
+	{
+		// A gap between rows closes everything that was open
+		for(uint8_t indi = 0; indi < _numPending; indi++){ sendRect(_pending[indi].x0, _pending[indi].y0, _pending[indi].x1, _row - 1); }
+		_numPending = 0;
+	}
+
+	// Both lists are in order of x, so one pass pairs up the spans that carry on unchanged
+	ILI9341_fill_span_t merged[ILI9341_FILL_MAX_SPANS];
+	uint8_t numMerged = 0;
+	uint8_t indi = 0;
+	uint8_t indj = 0;
+	while( (indi < _numPending) || (indj < numSpans) )
+	{
+		ILI9341_fill_span_t* open = (indi < _numPending) ? &_pending[indi] : NULL;
+		if((open != NULL) && (indj < numSpans) && (open->x0 == x0[indj]) && (open->x1 == x1[indj]))
+		{
+			merged[numMerged++] = *open;
+			indi++;
+			indj++;
+			continue;
+		}
+		if((open != NULL) && ((indj >= numSpans) || (open->x0 <= x0[indj])))
+		{
+			sendRect(open->x0, open->y0, open->x1, _row - 1);
+			indi++;
+			continue;
+		}
+		if( numMerged < ILI9341_FILL_MAX_SPANS )
+		{
+			merged[numMerged].x0 = x0[indj];
+			merged[numMerged].x1 = x1[indj];
+			merged[numMerged].y0 = y;
+			numMerged++;
+		}
+		else
+		{
+			sendRect(x0[indj], y, x1[indj], y);
+		}
+		indj++;
+	}
+	memcpy(_pending, merged, numMerged*sizeof(ILI9341_fill_span_t));
+	_numPending = numMerged;
+	_row = y + 1;
+}
+
+void ILI9341_Fill::end( void )
+{
+	for(uint8_t indi = 0; indi < _numPending; indi++){ sendRect(_pending[indi].x0, _pending[indi].y0, _pending[indi].x1, _row - 1); }
+	_numPending = 0;
+	_target->stopBatch();
+}
+
+
+
+// Shapes
+ILI9341_STAT_t ILI9341_Fill::polygon( const ILI9341_point_t* points, uint8_t numPoints )
+{
+	if( !_colorSet ){ return ILI9341_STAT_Error; }
+	if((points == NULL) || (numPoints < 3) || (numPoints > ILI9341_FILL_MAX_POINTS)){ return ILI9341_STAT_Error; }
+
+	// Build the edge table, horizontal edges never cross a row center so they are left out
+	uint8_t numEdges = 0;
+	int16_t yEnd = INT16_MIN;
+	for(uint8_t indi = 0; indi < numPoints; indi++)
+	{
+		const ILI9341_point_t* p = &points[indi];
+		const ILI9341_point_t* q = &points[(indi + 1) % numPoints];
+		if( p->y == q->y ){ continue; }
+		const ILI9341_point_t* top = (p->y < q->y) ? p : q;
+		const ILI9341_point_t* bottom = (p->y < q->y) ? q : p;
+		ILI9341_fill_edge_t edge;
+		edge.yTop = top->y;
+		edge.yBottom = bottom->y;
+		edge.height = bottom->y - top->y;
+		int32_t run = (int32_t)bottom->x - top->x;
+		int32_t step = run/edge.height;
+		int32_t rem = run % edge.height;
+		if( rem < 0 ){ rem += edge.height; step--; }		// Keep the fraction positive so x is always the floor
+		edge.x = top->x;
+		edge.err = 0;
+		edge.step = (int16_t)step;
+		edge.rem = (uint16_t)rem;
+		edge.winding = (p->y < q->y) ? 1 : -1;
+		if( edge.yBottom > yEnd ){ yEnd = edge.yBottom; }
+
+		// Insertion sort on the first row
+		uint8_t pos = numEdges;
+		while( (pos > 0) && (_edges[pos - 1].yTop > edge.yTop) )
+		{
+			_edges[pos] = _edges[pos - 1];
+			pos--;
+		}
+		_edges[pos] = edge;
+		numEdges++;
+	}
+	if( numEdges == 0 ){ return ILI9341_STAT_Nominal; }
+	if( yEnd > (int16_t)_target->yExt ){ yEnd = _target->yExt; }
+
+	uint8_t active[ILI9341_FILL_MAX_POINTS];
+	uint8_t numActive = 0;
+	uint8_t next = 0;
+	int16_t spanX0[ILI9341_FILL_MAX_POINTS/2];
+	int16_t spanX1[ILI9341_FILL_MAX_POINTS/2];
+
+	begin();
+	for(int16_t y = (_edges[0].yTop < 0) ? 0 : _edges[0].yTop; y < yEnd; y++)
+	{
+		// Bring in the edges that start on this row (or above the screen), and drop the ones that have ended
+		while( (next < numEdges) && (_edges[next].yTop <= y) )
+		{
+			ILI9341_fill_edge_t* edge = &_edges[next];
+			if( edge->yBottom > y )
+			{
+				uint32_t skip = y - edge->yTop;
+				uint32_t frac = (skip*edge->rem) + edge->err;
+				edge->x += (int16_t)((int32_t)skip*edge->step + (int32_t)(frac/edge->height));
+				edge->err = (uint16_t)(frac % edge->height);
+				active[numActive++] = next;
+			}
+			next++;
+		}
+		uint8_t kept = 0;
+		for(uint8_t indi = 0; indi < numActive; indi++)
+		{
+			if( _edges[active[indi]].yBottom > y ){ active[kept++] = active[indi]; }
+		}
+		numActive = kept;
+		if((numActive == 0) && (next == numEdges)){ break; }
+
+		// Crossings only swap where edges intersect, so the list stays nearly sorted
+		for(uint8_t indi = 1; indi < numActive; indi++)
+		{
+			uint8_t cur = active[indi];
+			uint8_t pos = indi;
+			while( (pos > 0) && crossesAfter(&_edges[active[pos - 1]], &_edges[cur]) )
+			{
+				active[pos] = active[pos - 1];
+				pos--;
+			}
+			active[pos] = cur;
+		}
+
+		// Nonzero winding - a span runs from where the count leaves zero to where it gets back
+		uint8_t numSpans = 0;
+		int8_t winding = 0;
+		int16_t xa = 0;
+		for(uint8_t indi = 0; indi < numActive; indi++)
+		{
+			ILI9341_fill_edge_t* edge = &_edges[active[indi]];
+			int8_t prev = winding;
+			winding += edge->winding;
+			if((prev == 0) && (winding != 0)){ xa = edge->x + ((edge->err != 0) ? 1 : 0); }	// First pixel center at or after the crossing
+			if((prev != 0) && (winding == 0))
+			{
+				int16_t xb = edge->x + ((edge->err != 0) ? 0 : -1);								// Last one before it
+				if( xa > xb ){ continue; }
+				if((numSpans != 0) && (xa <= spanX1[numSpans - 1] + 1)){ spanX1[numSpans - 1] = xb; continue; }
+				spanX0[numSpans] = xa;
+				spanX1[numSpans] = xb;
+				numSpans++;
+			}
+		}
+		addSpans(y, spanX0, spanX1, numSpans);
+
+		for(uint8_t indi = 0; indi < numActive; indi++)
+		{
+			ILI9341_fill_edge_t* edge = &_edges[active[indi]];
+			edge->x += edge->step;
+			edge->err += edge->rem;
+			if( edge->err >= edge->height ){ edge->err -= edge->height; edge->x++; }
+		}
+	}
+	end();
+	return ILI9341_STAT_Nominal;
+}
+
+bool ILI9341_Fill::crossesAfter( const ILI9341_fill_edge_t* a, const ILI9341_fill_edge_t* b )
+{
+	if( a->x != b->x ){ return (a->x > b->x); }
+	return ((uint32_t)a->err*b->height) > ((uint32_t)b->err*a->height);
+}
+
+ILI9341_STAT_t ILI9341_Fill::triangle( int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2 )
+{
+	ILI9341_point_t points[3] = { {x0, y0}, {x1, y1}, {x2, y2} };
+	return polygon(points, 3);
+}
+
+uint16_t ILI9341_Fill::isqrt( uint32_t value )
+{
+	uint32_t result = 0;
+	uint32_t bit = 1UL << 30;
+	while( bit > value ){ bit >>= 2; }
+	while( bit != 0 )
+	{
+		if( value >= result + bit )
+		{
+			value -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else
+		{
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (uint16_t)result;
+}
+
+void ILI9341_Fill::roundRows( int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius )
+{
+	if( x1 < x0 ){ int16_t temp = x0; x0 = x1; x1 = temp; }
+	if( y1 < y0 ){ int16_t temp = y0; y0 = y1; y1 = temp; }
+	if( radius > (uint16_t)((x1 - x0)/2) ){ radius = (x1 - x0)/2; }
+	if( radius > (uint16_t)((y1 - y0)/2) ){ radius = (y1 - y0)/2; }
+
+	// Each corner row is inset by how far the quarter circle falls short of the radius, the rows in between are all the same
+	uint32_t r2 = ((uint32_t)radius*radius) + radius;		// The extra radius rounds off the flat tips
+	int16_t yFirst = (y0 < 0) ? 0 : y0;
+	int16_t yLast = (y1 >= (int16_t)_target->yExt) ? (_target->yExt - 1) : y1;
+	for(int16_t y = yFirst; y <= yLast; y++)
+	{
+		int32_t dy = 0;
+		if( y < y0 + radius ){ dy = (y0 + radius) - y; }
+		else if( y > y1 - radius ){ dy = y - (y1 - radius); }
+		uint16_t inset = 0;
+		if( dy != 0 )
+		{
+			uint16_t w = isqrt(r2 - (uint32_t)(dy*dy));
+			if( w > radius ){ w = radius; }
+			inset = radius - w;
+		}
+		int16_t xa = x0 + inset;
+		int16_t xb = x1 - inset;
+		addSpans(y, &xa, &xb, 1);
+	}
+}
+
+ILI9341_STAT_t ILI9341_Fill::circle( int16_t x0, int16_t y0, uint16_t radius )
+{
+	if( !_colorSet ){ return ILI9341_STAT_Error; }
+	begin();
+	roundRows(x0 - radius, y0 - radius, x0 + radius, y0 + radius, radius);
+	end();
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_Fill::roundRect( int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius )
+{
+	if( !_colorSet ){ return ILI9341_STAT_Error; }
+	begin();
+	roundRows(x0, y0, x1, y1, radius);
+	end();
+	return ILI9341_STAT_Nominal;
+}
@@ -0,0 +1,100 @@
+/*
+
+Scanline fills for HyperDisplay ILI9341 - polygons (convex or not),
+triangles, circles and rounded rectangles are cut into one span per
+row and covered shape. Spans that repeat the one above them are merged
+so that the straight parts of a shape go out as one rectangular window,
+and everything else is sent with the bus held from start to finish.
+
+Polygons are built from an edge table and filled with the nonzero rule.
+Pixels are filled when their center (at integer coordinates) is inside
+the outline, with points on a left or top edge counted as inside, so
+shapes that share an edge never draw over each other. Circles and
+rounded rectangles include their bounding pixels, like hwrectangle.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_FILL_H
+#define HPYERDISPLAY_ILI9341_FILL_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_FILL_MAX_POINTS
+#define ILI9341_FILL_MAX_POINTS 32		// Also the most edges a polygon can have
+#endif
+#define ILI9341_FILL_MAX_SPANS 8		// Spans per row that can be merged with the next row, any more go out on their own
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef struct ILI9341_point{
+	int16_t x;
+	int16_t y;
+}ILI9341_point_t;
+
+typedef struct ILI9341_fill_edge{
+	int16_t yTop;				// First row the edge crosses
+	int16_t yBottom;			// First row past the end of the edge
+	int16_t x;					// Crossing on the current row is x + err/height, exactly
+	uint16_t err;
+	int16_t step;				// Change per row is step + rem/height
+	uint16_t rem;
+	uint16_t height;
+	int8_t winding;				// +1 going down, -1 going up
+}ILI9341_fill_edge_t;
+
+typedef struct ILI9341_fill_span{
+	int16_t x0;
+	int16_t x1;
+	int16_t y0;					// First row of the merged rectangle, the last one is the previous row
+}ILI9341_fill_span_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_Fill{
+private:
+protected:
+	ILI9341* _target;
+	uint8_t _color[ILI9341_MAX_BPP];
+	bool _colorSet;
+	uint32_t _windows;
+
+	ILI9341_fill_edge_t _edges[ILI9341_FILL_MAX_POINTS];
+	ILI9341_fill_span_t _pending[ILI9341_FILL_MAX_SPANS];	// Open rectangles, in order of x
+	uint8_t _numPending;
+	int16_t _row;
+
+	void begin( void );
+	void addSpans( int16_t y, const int16_t* x0, const int16_t* x1, uint8_t numSpans );	// Spans for one row, in order of x, rows must come in order
+	void end( void );
+	void sendRect( int16_t x0, int16_t y0, int16_t x1, int16_t y1 );
+
+	static bool crossesAfter( const ILI9341_fill_edge_t* a, const ILI9341_fill_edge_t* b );
+	static uint16_t isqrt( uint32_t value );
+	void roundRows( int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius );
+
+public:
+	ILI9341_Fill( ILI9341* target );
+
+	ILI9341_STAT_t setColor( color_t color );
+
+	ILI9341_STAT_t polygon( const ILI9341_point_t* points, uint8_t numPoints );
+	ILI9341_STAT_t triangle( int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2 );
+	ILI9341_STAT_t circle( int16_t x0, int16_t y0, uint16_t radius );
+	ILI9341_STAT_t roundRect( int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t radius );
+
+	uint32_t getWindowCount( void );			// Windows opened since the last reset
+	void resetWindowCount( void );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_FILL_H */
@@ -0,0 +1,147 @@
+#include "HyperDisplay_ILI9341_FrameDiff.h"
+
+
+ILI9341_FrameDiff::ILI9341_FrameDiff( ILI9341* target, uint16_t* table, size_t entries )
+{
+	_target = target;
+	_table = table;
+	_entries = (table == NULL) ? 0 : entries;
+	_segsPerRow = (_target->xExt + (ILI9341_DIFF_SEG_PIXELS - 1))/ILI9341_DIFF_SEG_PIXELS;
+	invalidate();
+	resetStats();
+}
+
+size_t ILI9341_FrameDiff::getTableEntries( hd_hw_extent_t width, hd_hw_extent_t height )
+{
+	return (size_t)((width + (ILI9341_DIFF_SEG_PIXELS - 1))/ILI9341_DIFF_SEG_PIXELS)*height;
+}
+
+void ILI9341_FrameDiff::invalidate( void )
+{
+	_valid = false;
+	_validRows = 0;
+}
+
+bool ILI9341_FrameDiff::isValid( void )
+{
+	return _valid;
+}
+
+uint16_t ILI9341_FrameDiff::hash( const uint8_t* data, size_t len )
+{
+	// FNV-1a folded down to 16 bits
+	uint32_t val = 2166136261UL;
+	for(size_t indi = 0; indi < len; indi++)
+	{
+		val ^= data[indi];
+		val *= 16777619UL;
+	}
+	return (uint16_t)((val >> 16) ^ val);
+}
+
+void ILI9341_FrameDiff::flushRows( const uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width )
+{
+	_stats.windows++;
+	_target->hwfillFromArray(0, y0, width - 1, y0 + (rows - 1), (color_t)band, (hd_pixels_t)width*rows);
+}
+
+ILI9341_STAT_t ILI9341_FrameDiff::sendBand( const uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	if((band == NULL) || (bpp == 0) || (rows == 0)){ return ILI9341_STAT_Error; }
+
+	size_t stride = (size_t)width*bpp;
+	hd_hw_extent_t segsPerRow = (width + (ILI9341_DIFF_SEG_PIXELS - 1))/ILI9341_DIFF_SEG_PIXELS;
+	if((segsPerRow != _segsPerRow) || ((size_t)(y0 + rows)*segsPerRow > _entries))
+	{
+		// No room to remember this band (or the width changed, e.g. after a rotation) so just send it
+		_segsPerRow = segsPerRow;
+		invalidate();
+		flushRows(band, y0, rows, width);
+		return ILI9341_STAT_Nominal;
+	}
+
+	hd_hw_extent_t fullStart = 0;		// Run of fully changed rows waiting to go out together
+	hd_hw_extent_t fullRows = 0;
+	for(hd_hw_extent_t row = 0; row < rows; row++)
+	{
+		const uint8_t* prow = band + (row*stride);
+		uint16_t* phashes = _table + ((size_t)(y0 + row)*segsPerRow);
+		bool known = (_valid || ((y0 + row) < _validRows));
+
+		// Hash every segment and mark the changed ones by storing their new hash
+		hd_hw_extent_t changed = 0;
+		int32_t spanStart = -1;
+		hd_hw_extent_t numSpans = 0;
+		hd_hw_extent_t spanSegs[2] = {0, 0};	// First span, kept in case it covers the whole row
+		for(hd_hw_extent_t seg = 0; seg < segsPerRow; seg++)
+		{
+			hd_hw_extent_t x0 = seg*ILI9341_DIFF_SEG_PIXELS;
+			hd_hw_extent_t len = ((width - x0) < ILI9341_DIFF_SEG_PIXELS) ? (width - x0) : ILI9341_DIFF_SEG_PIXELS;
+			uint16_t val = hash(prow + ((size_t)x0*bpp), (size_t)len*bpp);
+			_stats.segments++;
+
+			bool dirty = ((!known) || (phashes[seg] != val));
+			phashes[seg] = val;
+			if( dirty )
+			{
+				changed++;
+				if( spanStart < 0 ){ spanStart = seg; }
+			}
+			if((spanStart >= 0) && ((!dirty) || (seg == (segsPerRow - 1))))
+			{
+				// A span of changed segments just ended - rows that change completely are saved up instead
+				hd_hw_extent_t last = (dirty) ? seg : (seg - 1);
+				if( numSpans == 0 ){ spanSegs[0] = spanStart; spanSegs[1] = last; }
+				numSpans++;
+				if((spanStart != 0) || (last != (segsPerRow - 1)))
+				{
+					if( fullRows != 0 )
+					{
+						flushRows(band + (fullStart*stride), y0 + fullStart, fullRows, width);
+						fullRows = 0;
+					}
+					hd_hw_extent_t sx0 = spanStart*ILI9341_DIFF_SEG_PIXELS;
+					hd_hw_extent_t sx1 = ((last + 1)*ILI9341_DIFF_SEG_PIXELS) - 1;
+					if( sx1 > (width - 1) ){ sx1 = width - 1; }
+					_stats.windows++;
+					_target->hwfillFromArray(sx0, y0 + row, sx1, y0 + row, (color_t)(prow + ((size_t)sx0*bpp)), (hd_pixels_t)((sx1 - sx0) + 1));
+				}
+				spanStart = -1;
+			}
+		}
+		_stats.segmentsSent += changed;
+
+		bool full = ((numSpans == 1) && (spanSegs[0] == 0) && (spanSegs[1] == (segsPerRow - 1)));
+		if( full )
+		{
+			if( fullRows == 0 ){ fullStart = row; }
+			fullRows++;
+		}
+		else if( fullRows != 0 )
+		{
+			flushRows(band + (fullStart*stride), y0 + fullStart, fullRows, width);
+			fullRows = 0;
+		}
+	}
+	if( fullRows != 0 )
+	{
+		flushRows(band + (fullStart*stride), y0 + fullStart, fullRows, width);
+	}
+
+	// The table only becomes trustworthy once every row has been sent after an invalidate
+	if((!_valid) && (y0 <= _validRows) && ((y0 + rows) > _validRows)){ _validRows = y0 + rows; }
+	if((!_valid) && (_validRows >= _target->yExt)){ _valid = true; }
+	if((y0 + rows) >= _target->yExt){ _stats.frames++; }
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_diff_stats_t ILI9341_FrameDiff::getStats( void )
+{
+	return _stats;
+}
+
+void ILI9341_FrameDiff::resetStats( void )
+{
+	memset(&_stats, 0x00, sizeof(_stats));
+}
@@ -0,0 +1,78 @@
+/*
+
+Frame diffing for HyperDisplay ILI9341 - an alternative to keeping a
+full shadow framebuffer. Each rendered row is cut into segments of
+ILI9341_DIFF_SEG_PIXELS pixels and every segment is hashed. Hashes
+are compared with the table from the previous frame and only the 
+segments that changed are sent, merged into the longest spans 
+possible on each row. Fully changed rows that follow each other are
+sent together as one window.
+
+At 16 pixel segments a 240x320 screen needs 4800 table entries (a 
+little under 10 KB) which the caller supplies. A hash collision can
+leave a stale segment on the glass so call invalidate() to force a
+full frame now and then if that matters.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_FRAMEDIFF_H
+#define HPYERDISPLAY_ILI9341_FRAMEDIFF_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_DIFF_SEG_PIXELS
+#define ILI9341_DIFF_SEG_PIXELS 16
+#endif
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef struct ILI9341_diff_stats{
+	uint32_t frames;
+	uint32_t segments;				// Segments hashed
+	uint32_t segmentsSent;			// Segments that had changed
+	uint32_t windows;				// Windows opened to send them
+}ILI9341_diff_stats_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_FrameDiff{
+private:
+protected:
+	ILI9341* _target;
+	uint16_t* _table;
+	size_t _entries;
+	hd_hw_extent_t _segsPerRow;
+	bool _valid;					// False until every row has been sent once
+	hd_hw_extent_t _validRows;
+	ILI9341_diff_stats_t _stats;
+
+	static uint16_t hash( const uint8_t* data, size_t len );
+	void flushRows( const uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width );
+
+public:
+	ILI9341_FrameDiff( ILI9341* target, uint16_t* table, size_t entries );
+
+	static size_t getTableEntries( hd_hw_extent_t width, hd_hw_extent_t height );
+
+	void invalidate( void );			// Send everything on the next frame
+	bool isValid( void );
+
+	// Sends the parts of rows y0 to y0+rows-1 that changed since the last frame, same layout as ILI9341_band_render_t
+	ILI9341_STAT_t sendBand( const uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width );
+
+	ILI9341_diff_stats_t getStats( void );
+	void resetStats( void );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_FRAMEDIFF_H */
@@ -0,0 +1,576 @@
+#include "HyperDisplay_ILI9341_JPEG.h"
+
+#include <math.h>
+
+
+static const uint8_t ILI9341_zigzag[64] = {
+	 0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static uint8_t ILI9341_clampSample( int32_t val )
+{
+	if( val < 0 ){ return 0; }
+	if( val > 255 ){ return 255; }
+	return (uint8_t)val;
+}
+
+ILI9341_JPEG::ILI9341_JPEG( ILI9341* target )
+{
+	_target = target;
+	_reader = NULL;
+	_rowBuff = NULL;
+	_rowSize = 0;
+	_ready = false;
+	memset(&_info, 0x00, sizeof(_info));
+
+	// IDCT basis T[x][u] = C(u)/2 * cos((2x+1)u*pi/16)
+	for(uint8_t x = 0; x < 8; x++)
+	{
+		for(uint8_t u = 0; u < 8; u++)
+		{
+			float cu = (u == 0) ? (1.0/sqrt(2.0)) : 1.0;
+			_idct[(x*8) + u] = (int16_t)lroundf(4096.0*(cu/2.0)*cosf((((2*x) + 1)*u*M_PI)/16.0));
+		}
+	}
+}
+
+void ILI9341_JPEG::setRowBuffer( uint8_t* buff, size_t size )
+{
+	_rowBuff = buff;
+	_rowSize = (buff == NULL) ? 0 : size;
+}
+
+
+
+// Input
+uint8_t ILI9341_JPEG::readByte( void )
+{
+	if( _inPos >= _inLen )
+	{
+		_inLen = _reader->read(_in, ILI9341_JPEG_INBUF);
+		_inPos = 0;
+		if( _inLen == 0 )
+		{
+			_eof = true;
+			return 0x00;
+		}
+	}
+	return _in[_inPos++];
+}
+
+uint16_t ILI9341_JPEG::readWord( void )
+{
+	uint16_t val = ((uint16_t)readByte() << 8);
+	return (val | readByte());
+}
+
+void ILI9341_JPEG::fillBits( void )
+{
+	while( _bitCnt <= 24 )
+	{
+		uint8_t val = 0x00;
+		if((_marker == 0) && (!_eof))
+		{
+			val = readByte();
+			if( val == 0xFF )
+			{
+				uint8_t next = readByte();
+				if( next != 0x00 )
+				{
+					_marker = next;			// Past the end of the entropy coded data, pad with zeros
+					val = 0x00;
+				}
+			}
+		}
+		_bitBuf |= ((uint32_t)val << (24 - _bitCnt));
+		_bitCnt += 8;
+	}
+}
+
+uint16_t ILI9341_JPEG::getBits( uint8_t num )
+{
+	if( num == 0 ){ return 0; }
+	if( _bitCnt < num ){ fillBits(); }
+	uint16_t val = (uint16_t)(_bitBuf >> (32 - num));
+	_bitBuf <<= num;
+	_bitCnt -= num;
+	return val;
+}
+
+int16_t ILI9341_JPEG::receive( uint8_t num )
+{
+	// Read num bits and extend them to a signed value (JPEG F.12)
+	if( num == 0 ){ return 0; }
+	int32_t val = getBits(num);
+	if( val < ((int32_t)1 << (num - 1)) ){ val -= ((int32_t)1 << num) - 1; }
+	return (int16_t)val;
+}
+
+int16_t ILI9341_JPEG::decodeHuff( const ILI9341_jpeg_huff_t* table )
+{
+	int32_t code = getBits(1);
+	for(uint8_t len = 1; len <= 16; len++)
+	{
+		if( code <= table->maxcode[len] )
+		{
+			return table->vals[(uint8_t)(table->valptr[len] + (code - table->mincode[len]))];
+		}
+		code = (code << 1) | getBits(1);
+	}
+	return -1;		// Corrupt data
+}
+
+void ILI9341_JPEG::resetBits( void )
+{
+	_bitBuf = 0;
+	_bitCnt = 0;
+	_marker = 0;
+}
+
+
+
+// Headers
+ILI9341_STAT_t ILI9341_JPEG::readDQT( void )
+{
+	int32_t len = (int32_t)readWord() - 2;
+	while((len > 0) && (!_eof))
+	{
+		uint8_t pqtq = readByte();
+		if(((pqtq >> 4) != 0) || ((pqtq & 0x0F) > 3)){ return ILI9341_STAT_Error; }		// Only 8 bit tables are baseline
+		for(uint8_t indi = 0; indi < 64; indi++)
+		{
+			_qt[pqtq & 0x0F][indi] = readByte();
+		}
+		len -= 65;
+	}
+	return (_eof) ? ILI9341_STAT_Error : ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_JPEG::readDHT( void )
+{
+	int32_t len = (int32_t)readWord() - 2;
+	while((len > 0) && (!_eof))
+	{
+		uint8_t tcth = readByte();
+		if(((tcth >> 4) > 1) || ((tcth & 0x0F) > 1)){ return ILI9341_STAT_Error; }
+		ILI9341_jpeg_huff_t* table = &_huff[tcth >> 4][tcth & 0x0F];
+
+		uint8_t bits[17];
+		uint16_t total = 0;
+		for(uint8_t indi = 1; indi <= 16; indi++)
+		{
+			bits[indi] = readByte();
+			total += bits[indi];
+		}
+		if( total > 256 ){ return ILI9341_STAT_Error; }
+		for(uint16_t indi = 0; indi < total; indi++)
+		{
+			table->vals[indi] = readByte();
+		}
+
+		// Canonical codes (JPEG C.2 and F.15)
+		uint16_t code = 0;
+		uint16_t k = 0;
+		for(uint8_t indi = 1; indi <= 16; indi++)
+		{
+			table->valptr[indi] = (uint8_t)k;
+			table->mincode[indi] = code;
+			code += bits[indi];
+			k += bits[indi];
+			table->maxcode[indi] = (bits[indi] != 0) ? (int32_t)(code - 1) : -1;
+			code <<= 1;
+		}
+		table->maxcode[17] = -1;
+		table->valid = true;
+		len -= 17 + total;
+	}
+	return (_eof) ? ILI9341_STAT_Error : ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_JPEG::readSOF( void )
+{
+	readWord();
+	if( readByte() != 8 ){ return ILI9341_STAT_Error; }
+	_info.height = readWord();
+	_info.width = readWord();
+	_info.components = readByte();
+	if((_info.height == 0) || (_info.width == 0)){ return ILI9341_STAT_Error; }		// No DNL support
+	if((_info.components != 1) && (_info.components != 3)){ return ILI9341_STAT_Error; }
+
+	for(uint8_t indi = 0; indi < _info.components; indi++)
+	{
+		ILI9341_jpeg_comp_t* comp = &_comps[indi];
+		comp->id = readByte();
+		uint8_t hv = readByte();
+		comp->h = hv >> 4;
+		comp->v = hv & 0x0F;
+		comp->tq = readByte() & 0x03;
+	}
+
+	if( _info.components == 1 )
+	{
+		_comps[0].h = 1;		// A single component scan is always in 8x8 blocks
+		_comps[0].v = 1;
+	}
+	else
+	{
+		if((_comps[0].h < 1) || (_comps[0].h > 2) || (_comps[0].v < 1) || (_comps[0].v > 2)){ return ILI9341_STAT_Error; }
+		for(uint8_t indi = 1; indi < 3; indi++)
+		{
+			if((_comps[indi].h != 1) || (_comps[indi].v != 1)){ return ILI9341_STAT_Error; }
+		}
+	}
+	_info.mcuWidth = 8*_comps[0].h;
+	_info.mcuHeight = 8*_comps[0].v;
+	return (_eof) ? ILI9341_STAT_Error : ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_JPEG::readSOS( void )
+{
+	readWord();
+	uint8_t ns = readByte();
+	if( ns != _info.components ){ return ILI9341_STAT_Error; }		// Only one interleaved scan
+
+	for(uint8_t indi = 0; indi < ns; indi++)
+	{
+		uint8_t id = readByte();
+		uint8_t tables = readByte();
+		bool found = false;
+		for(uint8_t indj = 0; indj < _info.components; indj++)
+		{
+			if( _comps[indj].id != id ){ continue; }
+			_comps[indj].td = tables >> 4;
+			_comps[indj].ta = tables & 0x0F;
+			if((_comps[indj].td > 1) || (_comps[indj].ta > 1)){ return ILI9341_STAT_Error; }
+			if((!_huff[0][_comps[indj].td].valid) || (!_huff[1][_comps[indj].ta].valid)){ return ILI9341_STAT_Error; }
+			found = true;
+		}
+		if( !found ){ return ILI9341_STAT_Error; }
+	}
+	readByte();		// Spectral selection and successive approximation are fixed in baseline
+	readByte();
+	readByte();
+	return (_eof) ? ILI9341_STAT_Error : ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_JPEG::begin( ILI9341_Reader* reader )
+{
+	_reader = reader;
+	_ready = false;
+	_inLen = 0;
+	_inPos = 0;
+	_eof = false;
+	_restartInterval = 0;
+	_info.components = 0;
+	for(uint8_t indi = 0; indi < 4; indi++){ _huff[indi >> 1][indi & 0x01].valid = false; }
+	resetBits();
+	if( reader == NULL ){ return ILI9341_STAT_Error; }
+
+	if((readByte() != 0xFF) || (readByte() != 0xD8)){ return ILI9341_STAT_Error; }
+
+	while( !_eof )
+	{
+		if( readByte() != 0xFF ){ continue; }
+		uint8_t marker = readByte();
+		while( marker == 0xFF ){ marker = readByte(); }
+
+		ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+		switch( marker )
+		{
+			case 0xDB : retval = readDQT(); break;
+			case 0xC4 : retval = readDHT(); break;
+			case 0xC0 :								// Baseline
+			case 0xC1 : retval = readSOF(); break;	// Extended, fine as long as it is 8 bit Huffman
+			case 0xDD :
+				readWord();
+				_restartInterval = readWord();
+				break;
+
+			case 0xDA :
+				if( _info.components == 0 ){ return ILI9341_STAT_Error; }
+				retval = readSOS();
+				_ready = (retval == ILI9341_STAT_Nominal);
+				return retval;
+
+			case 0xC2 : case 0xC3 : case 0xC5 : case 0xC6 : case 0xC7 :
+			case 0xC9 : case 0xCA : case 0xCB : case 0xCD : case 0xCE : case 0xCF :
+			case 0xD9 :
+				return ILI9341_STAT_Error;			// Progressive, lossless, arithmetic or no image at all
+
+			default :
+			{
+				// APPn, COM and anything else we don't need
+				uint16_t len = readWord();
+				for(uint16_t indi = 2; (indi < len) && (!_eof); indi++){ readByte(); }
+				break;
+			}
+		}
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	}
+	return ILI9341_STAT_Error;
+}
+
+ILI9341_jpeg_info_t ILI9341_JPEG::getInfo( void )
+{
+	return _info;
+}
+
+ILI9341_JPEG_SCALE_t ILI9341_JPEG::fitScale( hd_hw_extent_t width, hd_hw_extent_t height )
+{
+	uint8_t shift = 0;
+	for( ; shift < ILI9341_JPEG_Scale8; shift++)
+	{
+		uint32_t w = ((uint32_t)_info.width + ((1 << shift) - 1)) >> shift;
+		uint32_t h = ((uint32_t)_info.height + ((1 << shift) - 1)) >> shift;
+		if((w <= width) && (h <= height)){ break; }
+	}
+	return (ILI9341_JPEG_SCALE_t)shift;
+}
+
+
+
+// Decoding
+ILI9341_STAT_t ILI9341_JPEG::restart( void )
+{
+	// Drop the padding bits and find the RSTn marker
+	uint8_t marker = _marker;
+	while((marker == 0) && (!_eof))
+	{
+		if( readByte() != 0xFF ){ continue; }
+		marker = readByte();
+		while( marker == 0xFF ){ marker = readByte(); }
+	}
+	resetBits();
+	for(uint8_t indi = 0; indi < _info.components; indi++){ _comps[indi].pred = 0; }
+	return ((marker >= 0xD0) && (marker <= 0xD7)) ? ILI9341_STAT_Nominal : ILI9341_STAT_Error;
+}
+
+ILI9341_STAT_t ILI9341_JPEG::decodeBlock( ILI9341_jpeg_comp_t* comp, uint8_t* samples, bool dcOnly )
+{
+	const uint8_t* q = _qt[comp->tq];
+	const ILI9341_jpeg_huff_t* ac = &_huff[1][comp->ta];
+
+	int16_t t = decodeHuff(&_huff[0][comp->td]);
+	if((t < 0) || (t > 11)){ return ILI9341_STAT_Error; }
+	comp->pred += receive((uint8_t)t);
+
+	memset(_coef, 0x00, sizeof(_coef));
+	_coef[0] = comp->pred*q[0];
+	bool acZero = true;
+	for(uint8_t k = 1; k < 64; )
+	{
+		int16_t rs = decodeHuff(ac);
+		if( rs < 0 ){ return ILI9341_STAT_Error; }
+		uint8_t r = rs >> 4;
+		uint8_t s = rs & 0x0F;
+		if( s == 0 )
+		{
+			if( r != 15 ){ break; }		// End of block
+			k += 16;
+			continue;
+		}
+		k += r;
+		if( k > 63 ){ return ILI9341_STAT_Error; }
+		int16_t val = receive(s);		// Always consumed, even when only the DC is wanted
+		if( !dcOnly )
+		{
+			_coef[ILI9341_zigzag[k]] = val*q[k];
+			acZero = false;
+		}
+		k++;
+	}
+
+	if( dcOnly || acZero )
+	{
+		memset(samples, ILI9341_clampSample(((_coef[0] + 4) >> 3) + 128), 64);		// A flat block, no need for the IDCT
+		return ILI9341_STAT_Nominal;
+	}
+	idct(samples);
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_JPEG::idct( uint8_t* samples )
+{
+	// Separable 8x8 inverse DCT in fixed point, columns first
+	int32_t tmp[64];
+	for(uint8_t u = 0; u < 8; u++)
+	{
+		for(uint8_t y = 0; y < 8; y++)
+		{
+			int32_t sum = 0;
+			for(uint8_t v = 0; v < 8; v++)
+			{
+				sum += (int32_t)_idct[(y*8) + v]*_coef[(v*8) + u];
+			}
+			tmp[(y*8) + u] = (sum + (1 << 9)) >> 10;		// Keep 2 fractional bits
+		}
+	}
+	for(uint8_t y = 0; y < 8; y++)
+	{
+		for(uint8_t x = 0; x < 8; x++)
+		{
+			int32_t sum = 0;
+			for(uint8_t u = 0; u < 8; u++)
+			{
+				sum += (int32_t)_idct[(x*8) + u]*tmp[(y*8) + u];
+			}
+			samples[(y*8) + x] = ILI9341_clampSample(((sum + (1 << 13)) >> 14) + 128);
+		}
+	}
+}
+
+void ILI9341_JPEG::convertRow( uint8_t* pdst, hd_hw_extent_t oy, hd_hw_extent_t numPixels, uint8_t shift, uint8_t bpp )
+{
+	uint8_t hf = _comps[0].h;
+	uint8_t vf = _comps[0].v;
+	uint8_t box = 1 << shift;
+	uint8_t lumaBlocks = hf*vf;
+	uint16_t py = oy*box;
+
+	for(hd_hw_extent_t ox = 0; ox < numPixels; ox++)
+	{
+		uint16_t px = ox*box;
+
+		// Average the samples under the output pixel
+		uint16_t sum = 0;
+		for(uint8_t j = 0; j < box; j++)
+		{
+			uint16_t sy = py + j;
+			const uint8_t* prow = _samples[((sy >> 3)*hf)] + ((sy & 0x07)*8);
+			for(uint8_t i = 0; i < box; i++)
+			{
+				uint16_t sx = px + i;
+				sum += prow[((sx >> 3)*64) + (sx & 0x07)];
+			}
+		}
+		int32_t luma = sum >> (2*shift);
+		int32_t r = luma, g = luma, b = luma;
+		if( _info.components == 3 )
+		{
+			uint8_t cw = (box > hf) ? (box/hf) : 1;
+			uint8_t ch = (box > vf) ? (box/vf) : 1;
+			int32_t cb = 0;
+			int32_t cr = 0;
+			for(uint8_t j = 0; j < ch; j++)
+			{
+				uint8_t cindex = (((py/vf) + j)*8) + (px/hf);
+				for(uint8_t i = 0; i < cw; i++)
+				{
+					cb += _samples[lumaBlocks][cindex + i];
+					cr += _samples[lumaBlocks + 1][cindex + i];
+				}
+			}
+			cb = (cb/(cw*ch)) - 128;
+			cr = (cr/(cw*ch)) - 128;
+			r = luma + (((91881*cr) + 32768) >> 16);
+			g = luma - (((22554*cb) + (46802*cr) + 32768) >> 16);
+			b = luma + (((116130*cb) + 32768) >> 16);
+		}
+		uint8_t rc = ILI9341_clampSample(r);
+		uint8_t gc = ILI9341_clampSample(g);
+		uint8_t bc = ILI9341_clampSample(b);
+
+		if( bpp == 2 )
+		{
+			*(pdst++) = (rc & 0xF8) | (gc >> 5);
+			*(pdst++) = ((gc << 3) & 0xE0) | (bc >> 3);
+		}
+		else
+		{
+			*(pdst++) = rc & 0xFC;
+			*(pdst++) = gc & 0xFC;
+			*(pdst++) = bc & 0xFC;
+		}
+	}
+}
+
+ILI9341_STAT_t ILI9341_JPEG::decode( hd_hw_extent_t x0, hd_hw_extent_t y0, ILI9341_JPEG_SCALE_t scale )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	if((!_ready) || (bpp == 0) || (scale > ILI9341_JPEG_Scale8)){ return ILI9341_STAT_Error; }
+	_ready = false;		// The data can only be read once
+
+	uint8_t shift = (uint8_t)scale;
+	bool dcOnly = (scale == ILI9341_JPEG_Scale8);
+	hd_hw_extent_t outMcuW = _info.mcuWidth >> shift;
+	hd_hw_extent_t outMcuH = _info.mcuHeight >> shift;
+	uint16_t mcusX = (_info.width + (_info.mcuWidth - 1))/_info.mcuWidth;
+	uint16_t mcusY = (_info.height + (_info.mcuHeight - 1))/_info.mcuHeight;
+
+	// What of the scaled image lands on the screen
+	if((x0 >= _target->xExt) || (y0 >= _target->yExt)){ return ILI9341_STAT_Nominal; }
+	hd_hw_extent_t visW = (_info.width + ((1 << shift) - 1)) >> shift;
+	hd_hw_extent_t visH = (_info.height + ((1 << shift) - 1)) >> shift;
+	if( visW > (_target->xExt - x0) ){ visW = _target->xExt - x0; }
+	if( visH > (_target->yExt - y0) ){ visH = _target->yExt - y0; }
+
+	size_t size = 0;
+	uint8_t* scratch = _target->getScratch(&size);
+	bool batch = ((_rowBuff != NULL) && (((size_t)visW*outMcuH*bpp) <= _rowSize));
+	if((!batch) && (size < ((size_t)outMcuW*bpp))){ return ILI9341_STAT_Error; }
+
+	for(uint8_t indi = 0; indi < _info.components; indi++){ _comps[indi].pred = 0; }
+	uint32_t mcuCount = 0;
+	for(uint16_t my = 0; my < mcusY; my++)
+	{
+		hd_hw_extent_t oy0 = my*outMcuH;
+		if( oy0 >= visH ){ break; }		// Everything else is off the bottom of the screen
+		hd_hw_extent_t rows = ((visH - oy0) < outMcuH) ? (visH - oy0) : outMcuH;
+
+		for(uint16_t mx = 0; mx < mcusX; mx++)
+		{
+			if((_restartInterval != 0) && (mcuCount != 0) && ((mcuCount % _restartInterval) == 0))
+			{
+				if( restart() != ILI9341_STAT_Nominal ){ return ILI9341_STAT_Error; }
+			}
+			mcuCount++;
+
+			uint8_t block = 0;
+			for(uint8_t indi = 0; indi < _info.components; indi++)
+			{
+				for(uint8_t indj = 0; indj < (_comps[indi].h*_comps[indi].v); indj++)
+				{
+					if( decodeBlock(&_comps[indi], _samples[block++], dcOnly) != ILI9341_STAT_Nominal ){ return ILI9341_STAT_Error; }
+				}
+			}
+
+			hd_hw_extent_t ox0 = mx*outMcuW;
+			if( ox0 >= visW ){ continue; }		// Still has to be decoded to keep the predictors right
+			hd_hw_extent_t cols = ((visW - ox0) < outMcuW) ? (visW - ox0) : outMcuW;
+
+			if( batch )
+			{
+				for(hd_hw_extent_t row = 0; row < rows; row++)
+				{
+					convertRow(_rowBuff + ((((size_t)row*visW) + ox0)*bpp), row, cols, shift, bpp);
+				}
+				continue;
+			}
+
+			_target->setWindow(x0 + ox0, y0 + oy0, x0 + ox0 + (cols - 1), y0 + oy0 + (rows - 1));
+			_target->startRAMWrite();
+			for(hd_hw_extent_t row = 0; row < rows; row++)
+			{
+				convertRow(scratch, row, cols, shift, bpp);
+				_target->continueRAMWrite(scratch, (size_t)cols*bpp);
+			}
+			_target->stopRAMWrite();
+		}
+
+		if( batch )
+		{
+			_target->setWindow(x0, y0 + oy0, x0 + (visW - 1), y0 + oy0 + (rows - 1));
+			_target->startRAMWrite();
+			_target->continueRAMWrite(_rowBuff, (size_t)visW*rows*bpp);
+			_target->stopRAMWrite();
+		}
+	}
+	return ILI9341_STAT_Nominal;
+}
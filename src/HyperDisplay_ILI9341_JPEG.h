@@ -0,0 +1,142 @@
+/*
+
+Baseline JPEG decoder for HyperDisplay ILI9341 - decodes straight 
+into GRAM one MCU at a time so a photo never needs a full frame 
+buffer. Each MCU is color converted to the active pixel format and 
+sent as its own window, one row of pixels at a time out of the 
+scratch arena. Given a row buffer big enough for a whole row of MCUs
+the row is sent as one taller window instead.
+
+Decoding at 1/2, 1/4 or 1/8 scale is supported for thumbnails. At 1/8
+only the DC coefficients are used so the IDCT is skipped altogether.
+
+Supports baseline (and extended 8 bit Huffman) frames with grayscale 
+or YCbCr at 4:4:4, 4:2:2, 4:4:0 and 4:2:0, plus restart markers. 
+Progressive and arithmetic coded files are rejected.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_JPEG_H
+#define HPYERDISPLAY_ILI9341_JPEG_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+#include "HyperDisplay_ILI9341_Reader.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_JPEG_INBUF
+#define ILI9341_JPEG_INBUF 64				// Bytes pulled from the reader at a time
+#endif
+
+#define ILI9341_JPEG_MAX_COMPS 3
+#define ILI9341_JPEG_MAX_BLOCKS 6			// 4:2:0 is four luma blocks plus one of each chroma
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef enum{
+	ILI9341_JPEG_Scale1 = 0x00,				// Values are the shift applied to the size
+	ILI9341_JPEG_Scale2,
+	ILI9341_JPEG_Scale4,
+	ILI9341_JPEG_Scale8
+}ILI9341_JPEG_SCALE_t;
+
+typedef struct ILI9341_jpeg_huff{
+	uint8_t vals[256];
+	int32_t maxcode[18];					// Largest code of each length, -1 if none
+	uint16_t mincode[17];
+	uint8_t valptr[17];
+	bool valid;
+}ILI9341_jpeg_huff_t;
+
+typedef struct ILI9341_jpeg_comp{
+	uint8_t id;
+	uint8_t h;								// Sampling factors
+	uint8_t v;
+	uint8_t tq;								// Quantization table
+	uint8_t td;								// DC and AC Huffman tables
+	uint8_t ta;
+	int16_t pred;							// DC predictor
+}ILI9341_jpeg_comp_t;
+
+typedef struct ILI9341_jpeg_info{
+	uint16_t width;
+	uint16_t height;
+	uint8_t components;
+	uint8_t mcuWidth;
+	uint8_t mcuHeight;
+}ILI9341_jpeg_info_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_JPEG{
+private:
+protected:
+	ILI9341* _target;
+	ILI9341_Reader* _reader;
+	uint8_t* _rowBuff;
+	size_t _rowSize;
+
+	// Input
+	uint8_t _in[ILI9341_JPEG_INBUF];
+	size_t _inLen;
+	size_t _inPos;
+	bool _eof;
+	uint32_t _bitBuf;
+	uint8_t _bitCnt;
+	uint8_t _marker;						// Marker that stopped the entropy coded data, 0 if none
+
+	// Tables
+	uint8_t _qt[4][64];						// Zig-zag order
+	ILI9341_jpeg_huff_t _huff[2][2];		// [DC, AC][id]
+	int16_t _idct[64];						// Basis, scaled by 4096
+
+	// Frame
+	ILI9341_jpeg_info_t _info;
+	ILI9341_jpeg_comp_t _comps[ILI9341_JPEG_MAX_COMPS];
+	uint16_t _restartInterval;
+	bool _ready;
+
+	// One MCU worth of samples
+	int16_t _coef[64];
+	uint8_t _samples[ILI9341_JPEG_MAX_BLOCKS][64];
+
+	uint8_t readByte( void );
+	uint16_t readWord( void );
+	void fillBits( void );
+	uint16_t getBits( uint8_t num );
+	int16_t receive( uint8_t num );
+	int16_t decodeHuff( const ILI9341_jpeg_huff_t* table );
+	void resetBits( void );
+
+	ILI9341_STAT_t readDQT( void );
+	ILI9341_STAT_t readDHT( void );
+	ILI9341_STAT_t readSOF( void );
+	ILI9341_STAT_t readSOS( void );
+	ILI9341_STAT_t restart( void );
+
+	ILI9341_STAT_t decodeBlock( ILI9341_jpeg_comp_t* comp, uint8_t* samples, bool dcOnly );
+	void idct( uint8_t* samples );
+	void convertRow( uint8_t* pdst, hd_hw_extent_t oy, hd_hw_extent_t numPixels, uint8_t shift, uint8_t bpp );
+
+public:
+	ILI9341_JPEG( ILI9341* target );
+
+	void setRowBuffer( uint8_t* buff, size_t size );		// Optional, batches each row of MCUs into one window when it fits
+
+	ILI9341_STAT_t begin( ILI9341_Reader* reader );		// Reads the headers up to the start of the image data
+	ILI9341_jpeg_info_t getInfo( void );
+	ILI9341_JPEG_SCALE_t fitScale( hd_hw_extent_t width, hd_hw_extent_t height );	// Largest scale whose output fits
+
+	ILI9341_STAT_t decode( hd_hw_extent_t x0, hd_hw_extent_t y0, ILI9341_JPEG_SCALE_t scale = ILI9341_JPEG_Scale1 );	// Top left corner in hardware pixels, clipped to the screen
+};
+
+#endif /* HPYERDISPLAY_ILI9341_JPEG_H */
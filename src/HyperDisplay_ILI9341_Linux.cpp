@@ -0,0 +1,372 @@
+#include "HyperDisplay_ILI9341_Linux.h"
+
+#if defined(__linux__)
+#include <linux/gpio.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+
+
+ILI9341_LinuxSPI::ILI9341_LinuxSPI(uint16_t xSize, uint16_t ySize) : hyperdisplay( xSize, ySize ), ILI9341_4WSPI(xSize, ySize)
+{
+	_spiFd = -1;
+	_dcFd = -1;
+	_spidev = false;
+	_bufsiz = ILI9341_LINUX_DEFAULT_BUFSIZ;
+	_chunk = ILI9341_LINUX_STAGE_SIZE;
+	_dcLevel = -1;
+	_ramWrite = false;
+	_staged = 0;
+	_numXfers = 0;
+	memset(&_stats, 0x00, sizeof(_stats));
+}
+
+ILI9341_LinuxSPI::~ILI9341_LinuxSPI( void )
+{
+	end();
+}
+
+uint32_t ILI9341_LinuxSPI::readBufsiz( const char* path )
+{
+	uint32_t bufsiz = 0;
+	FILE* file = (path == NULL) ? NULL : fopen(path, "r");
+	if( file != NULL )
+	{
+		unsigned long value = 0;
+		if( fscanf(file, "%lu", &value) == 1 ){ bufsiz = (uint32_t)value; }
+		fclose(file);
+	}
+	return (bufsiz == 0) ? ILI9341_LINUX_DEFAULT_BUFSIZ : bufsiz;
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::begin( const char* spiPath, const char* gpioPath, uint32_t dcLine, const char* bufsizPath )
+{
+	end();
+	if( spiPath == NULL ){ return ILI9341_STAT_Error; }
+	_spiFd = open(spiPath, O_RDWR);
+	if( _spiFd < 0 ){ return ILI9341_STAT_Error; }
+
+	// Only spidev answers its own ioctls, anything else is treated as a plain file
+	uint8_t mode = 0;
+	_spidev = (ioctl(_spiFd, SPI_IOC_RD_MODE, &mode) == 0);
+	if( _spidev )
+	{
+		uint8_t bits = 8;
+		uint32_t speed = _spiFreq;
+		mode = SPI_MODE_0;
+		if((ioctl(_spiFd, SPI_IOC_WR_MODE, &mode) < 0) || (ioctl(_spiFd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) || (ioctl(_spiFd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0))
+		{
+			end();
+			return ILI9341_STAT_Error;
+		}
+	}
+	_bufsiz = readBufsiz(bufsizPath);
+	_chunk = (_bufsiz < ILI9341_LINUX_STAGE_SIZE) ? _bufsiz : ILI9341_LINUX_STAGE_SIZE;
+
+	if( gpioPath != NULL )
+	{
+		int chipFd = open(gpioPath, O_RDWR);
+		if( chipFd < 0 ){ end(); return ILI9341_STAT_Error; }
+		struct gpiohandle_request req;
+		memset(&req, 0x00, sizeof(req));
+		req.lineoffsets[0] = dcLine;
+		req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+		req.default_values[0] = 1;
+		req.lines = 1;
+		strncpy(req.consumer_label, "ili9341-dc", sizeof(req.consumer_label) - 1);
+		int status = ioctl(chipFd, GPIO_GET_LINEHANDLE_IOCTL, &req);
+		close(chipFd);				// The line handle stays valid on its own
+		if( status < 0 ){ end(); return ILI9341_STAT_Error; }
+		_dcFd = req.fd;
+		_dcLevel = 1;
+	}
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_LinuxSPI::end( void )
+{
+	if( _spiFd >= 0 )
+	{
+		flush();
+		close(_spiFd);
+	}
+	if( _dcFd >= 0 ){ close(_dcFd); }
+	_spiFd = -1;
+	_dcFd = -1;
+	_dcLevel = -1;
+	_spidev = false;
+	_ramWrite = false;
+	_batch = false;
+	_staged = 0;
+	_numXfers = 0;
+}
+
+uint32_t ILI9341_LinuxSPI::getBufsiz( void )
+{
+	return _bufsiz;
+}
+
+bool ILI9341_LinuxSPI::isSpidev( void )
+{
+	return _spidev;
+}
+
+const ILI9341_linux_stats_t* ILI9341_LinuxSPI::getStats( void )
+{
+	return &_stats;
+}
+
+void ILI9341_LinuxSPI::resetStats( void )
+{
+	memset(&_stats, 0x00, sizeof(_stats));
+}
+
+
+
+// Queueing
+ILI9341_STAT_t ILI9341_LinuxSPI::append( const uint8_t* pdata, size_t len, bool dc )
+{
+	if( _numXfers == ILI9341_LINUX_MAX_XFERS )
+	{
+		ILI9341_STAT_t retval = flush();
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	}
+	struct spi_ioc_transfer* xfer = &_xfers[_numXfers];
+	memset(xfer, 0x00, sizeof(struct spi_ioc_transfer));
+	xfer->tx_buf = (uint64_t)(uintptr_t)pdata;
+	xfer->len = (uint32_t)len;
+	xfer->speed_hz = _spiFreq;
+	xfer->bits_per_word = 8;
+	_xferDC[_numXfers] = dc;
+	_numXfers++;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::queue( const uint8_t* pdata, size_t len, bool dc )
+{
+	if( _spiFd < 0 ){ return ILI9341_STAT_Error; }
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+
+	if( len > (_chunk - _staged) )
+	{
+		// Too big to stage - point the transfers at the caller's memory and send them before it can change
+		while( len )
+		{
+			size_t count = (len > _bufsiz) ? _bufsiz : len;
+			retval = append(pdata, count, dc);
+			if( retval != ILI9341_STAT_Nominal ){ return retval; }
+			pdata += count;
+			len -= count;
+		}
+		return flush();
+	}
+
+	if( _numXfers == ILI9341_LINUX_MAX_XFERS )
+	{
+		// Make room first, a flush in append would hand the stage back while these bytes still sit in it
+		retval = flush();
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	}
+	uint8_t* pdst = _stage + _staged;
+	memcpy(pdst, pdata, len);
+	_staged += len;
+	if( _numXfers != 0 )
+	{
+		// Same level and right after the last staged bytes, so it just gets longer
+		struct spi_ioc_transfer* last = &_xfers[_numXfers - 1];
+		if( (_xferDC[_numXfers - 1] == dc) && ((uintptr_t)(last->tx_buf + last->len) == (uintptr_t)pdst) )
+		{
+			last->len += (uint32_t)len;
+			return ILI9341_STAT_Nominal;
+		}
+	}
+	return append(pdst, len, dc);
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::setDC( bool level )
+{
+	if( _dcFd < 0 ){ return ILI9341_STAT_Nominal; }
+	if( _dcLevel == (int8_t)level ){ return ILI9341_STAT_Nominal; }
+	struct gpiohandle_data values;
+	memset(&values, 0x00, sizeof(values));
+	values.values[0] = level ? 1 : 0;
+	_stats.gpioCalls++;
+	if( ioctl(_dcFd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &values) < 0 )
+	{
+		_dcLevel = -1;
+		return ILI9341_STAT_Error;
+	}
+	_dcLevel = (int8_t)level;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::sendMessage( struct spi_ioc_transfer* xfers, uint8_t numXfers )
+{
+	_stats.spiCalls++;
+	_stats.transfers += numXfers;
+	size_t total = 0;
+	for(uint8_t indi = 0; indi < numXfers; indi++){ total += xfers[indi].len; }
+	_stats.bytes += (uint32_t)total;
+
+	if( _spidev )
+	{
+		unsigned long request = _IOC(_IOC_WRITE, SPI_IOC_MAGIC, 0, SPI_MSGSIZE(numXfers));	// SPI_IOC_MESSAGE(n) for an n only known at run time
+		return (ioctl(_spiFd, request, xfers) < 0) ? ILI9341_STAT_Error : ILI9341_STAT_Nominal;
+	}
+
+	struct iovec iov[ILI9341_LINUX_MAX_XFERS];
+	for(uint8_t indi = 0; indi < numXfers; indi++)
+	{
+		iov[indi].iov_base = (void*)(uintptr_t)xfers[indi].tx_buf;
+		iov[indi].iov_len = xfers[indi].len;
+	}
+	return (writev(_spiFd, iov, numXfers) == (ssize_t)total) ? ILI9341_STAT_Nominal : ILI9341_STAT_Error;
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::flush( void )
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	uint8_t indi = 0;
+	while( indi < _numXfers )
+	{
+		// D/C can only change between messages (when there is a line to change), and spidev takes at most bufsiz per message
+		bool dc = _xferDC[indi];
+		uint8_t first = indi;
+		size_t total = 0;
+		while( (indi < _numXfers) && ((_xferDC[indi] == dc) || (_dcFd < 0)) && ((total + _xfers[indi].len) <= _bufsiz) )
+		{
+			total += _xfers[indi].len;
+			indi++;
+		}
+		if( setDC(dc) != ILI9341_STAT_Nominal ){ retval = ILI9341_STAT_Error; break; }
+		if( sendMessage(&_xfers[first], indi - first) != ILI9341_STAT_Nominal ){ retval = ILI9341_STAT_Error; break; }
+	}
+	_numXfers = 0;
+	_staged = 0;
+	return retval;
+}
+
+
+
+////////////////////////////////////////////////////////////
+//				Display Interface Functions				  //
+////////////////////////////////////////////////////////////
+ILI9341_STAT_t ILI9341_LinuxSPI::writePacket(ILI9341_CMD_t* pcmd, uint8_t* pdata, uint16_t dlen)
+{
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	if(pcmd != NULL)
+	{
+		uint8_t cmd = (uint8_t)*pcmd;
+		retval = queue(&cmd, 1, false);
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	}
+	if( (pdata != NULL) && (dlen != 0) )
+	{
+		retval = queue(pdata, dlen, true);
+		if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	}
+
+	// The column and row addresses only matter to the RAM command that follows, so they ride along with it
+	if( _batch || _ramWrite ){ return ILI9341_STAT_Nominal; }
+	if( (pcmd != NULL) && ((*pcmd == ILI9341_CMD_CASET) || (*pcmd == ILI9341_CMD_RASET)) ){ return ILI9341_STAT_Nominal; }
+	return flush();
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::readPacket(ILI9341_CMD_t* pcmd, uint8_t* pdata, uint16_t dlen, uint8_t dummyBytes)
+{
+	if( _batch || !_spidev ){ return ILI9341_STAT_Error; }		// Reads need their own clock, and a real device
+	ILI9341_STAT_t retval = flush();
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+
+	// cs_change on the last transfer of a message keeps the chip selected, otherwise the read would be cut off
+	struct spi_ioc_transfer xfer;
+	if(pcmd != NULL)
+	{
+		uint8_t cmd = (uint8_t)*pcmd;
+		memset(&xfer, 0x00, sizeof(xfer));
+		xfer.tx_buf = (uint64_t)(uintptr_t)&cmd;
+		xfer.len = 1;
+		xfer.speed_hz = _spiReadFreq;
+		xfer.bits_per_word = 8;
+		xfer.cs_change = 1;
+		if( setDC(false) != ILI9341_STAT_Nominal ){ return ILI9341_STAT_Error; }
+		if( sendMessage(&xfer, 1) != ILI9341_STAT_Nominal ){ return ILI9341_STAT_Error; }
+	}
+	if( setDC(true) != ILI9341_STAT_Nominal ){ return ILI9341_STAT_Error; }
+
+	size_t remaining = (size_t)dummyBytes + ((pdata != NULL) ? dlen : 0);
+	size_t skip = dummyBytes;
+	while( remaining )
+	{
+		size_t count = (remaining > _chunk) ? _chunk : remaining;
+		memset(&xfer, 0x00, sizeof(xfer));
+		xfer.rx_buf = (uint64_t)(uintptr_t)_stage;		// Nothing is queued during a read so the stage is free
+		xfer.len = (uint32_t)count;
+		xfer.speed_hz = _spiReadFreq;
+		xfer.bits_per_word = 8;
+		xfer.cs_change = (remaining > count) ? 1 : 0;
+		if( sendMessage(&xfer, 1) != ILI9341_STAT_Nominal ){ return ILI9341_STAT_Error; }
+		size_t dropped = (skip > count) ? count : skip;
+		if( pdata != NULL )
+		{
+			memcpy(pdata, _stage + dropped, count - dropped);
+			pdata += (count - dropped);
+		}
+		skip -= dropped;
+		remaining -= count;
+	}
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::startRAMWrite( void )
+{
+	ILI9341_CMD_t cmd = ILI9341_CMD_WRRAM;
+	_ramWrite = true;
+	return writePacket(&cmd);		// Queued along with the window, the pixels join them until stopRAMWrite
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::continueRAMWrite( uint8_t* pdata, size_t numBytes )
+{
+	if( (pdata == NULL) || (numBytes == 0) ){ return ILI9341_STAT_Nominal; }
+	return queue(pdata, numBytes, true);
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::stopRAMWrite( void )
+{
+	_ramWrite = false;
+	if( _batch ){ return ILI9341_STAT_Nominal; }		// stopBatch sends it all
+	return flush();
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::waitForBus( void )
+{
+	if( _ramWrite || _batch ){ return ILI9341_STAT_Nominal; }
+	return flush();
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::startBatch( void )
+{
+	if( _batch ){ return ILI9341_STAT_Error; }
+	_batch = true;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::stopBatch( void )
+{
+	if( !_batch ){ return ILI9341_STAT_Error; }
+	_batch = false;
+	if( _ramWrite ){ return ILI9341_STAT_Nominal; }
+	return flush();
+}
+
+void ILI9341_LinuxSPI::retuneSPI( void )
+{
+}
+
+ILI9341_STAT_t ILI9341_LinuxSPI::transferSPIbuffer(uint8_t* pdata, size_t count, bool ){
+	return queue(pdata, count, true);
+}
+
+#endif /* __linux__ */
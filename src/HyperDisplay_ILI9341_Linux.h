@@ -0,0 +1,108 @@
+/*
+
+Linux backend for HyperDisplay ILI9341 - 4 wire SPI through spidev
+(/dev/spidevB.C) with the D/C line driven through the gpiochip
+character device (/dev/gpiochipN). It derives from ILI9341_4WSPI so
+every hw primitive is the same, only the transport changes.
+
+System calls are the expensive part here, so packets are queued
+instead of sent. Window setup, the RAM write command and the pixels
+that follow all go out together when the primitive finishes, as one
+SPI_IOC_MESSAGE per run of bytes with the same D/C level (a windowed
+write is always three command and three data runs) plus one per
+spidev bufsiz worth of payload. Small pieces are copied into a staging
+buffer, large ones are sent straight from the caller's memory.
+
+The device paths are passed to begin() so a host build can point it
+at any file - when the SPI path isn't a spidev node everything is
+written to it with writev() instead, and reads fail. Passing NULL for
+the gpiochip leaves D/C alone.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_LINUX_H
+#define HPYERDISPLAY_ILI9341_LINUX_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+#if defined(__linux__)
+#include <linux/spi/spidev.h>
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#define ILI9341_LINUX_BUFSIZ_PATH "/sys/module/spidev/parameters/bufsiz"
+#define ILI9341_LINUX_DEFAULT_BUFSIZ 4096		// spidev's own default, used when the parameter can't be read
+#ifndef ILI9341_LINUX_STAGE_SIZE
+#define ILI9341_LINUX_STAGE_SIZE 4096			// Staging for small packets, also the most that goes out per message when bufsiz is bigger
+#endif
+#define ILI9341_LINUX_MAX_XFERS 16				// Transfers queued before a flush is forced
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef struct ILI9341_linux_stats{
+	uint32_t spiCalls;			// SPI_IOC_MESSAGE ioctls (or writev calls)
+	uint32_t gpioCalls;			// D/C changes
+	uint32_t transfers;			// Transfers inside those messages
+	uint32_t bytes;
+}ILI9341_linux_stats_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_LinuxSPI : public ILI9341_4WSPI{
+private:
+protected:
+	ILI9341_LinuxSPI(uint16_t xSize, uint16_t ySize);
+	~ILI9341_LinuxSPI( void );
+
+	int _spiFd;
+	int _dcFd;					// Line handle from the gpiochip, -1 when D/C isn't driven
+	bool _spidev;				// False for a stand-in file
+	uint32_t _bufsiz;
+	size_t _chunk;				// Largest single transfer - bufsiz, or the stage if that is smaller
+	int8_t _dcLevel;			// Last level set, -1 when unknown
+	bool _ramWrite;				// Between startRAMWrite and stopRAMWrite
+
+	uint8_t _stage[ILI9341_LINUX_STAGE_SIZE];
+	size_t _staged;
+	struct spi_ioc_transfer _xfers[ILI9341_LINUX_MAX_XFERS];
+	bool _xferDC[ILI9341_LINUX_MAX_XFERS];
+	uint8_t _numXfers;
+	ILI9341_linux_stats_t _stats;
+
+	ILI9341_STAT_t queue( const uint8_t* pdata, size_t len, bool dc );	// Copies into the stage or sends directly, never returns with the caller's memory still queued
+	ILI9341_STAT_t append( const uint8_t* pdata, size_t len, bool dc );
+	ILI9341_STAT_t flush( void );
+	ILI9341_STAT_t sendMessage( struct spi_ioc_transfer* xfers, uint8_t numXfers );
+	ILI9341_STAT_t setDC( bool level );
+	static uint32_t readBufsiz( const char* path );
+	void retuneSPI( void );				// Nothing to do, every transfer carries its own clock
+
+public:
+	ILI9341_STAT_t begin( const char* spiPath, const char* gpioPath, uint32_t dcLine, const char* bufsizPath = ILI9341_LINUX_BUFSIZ_PATH );
+	void end( void );
+	uint32_t getBufsiz( void );
+	bool isSpidev( void );
+	const ILI9341_linux_stats_t* getStats( void );
+	void resetStats( void );
+
+	ILI9341_STAT_t writePacket(ILI9341_CMD_t* pcmd = NULL, uint8_t* pdata = NULL, uint16_t dlen = 0);	// Window setup waits for the command that uses it, anything else goes out straight away
+	ILI9341_STAT_t readPacket(ILI9341_CMD_t* pcmd = NULL, uint8_t* pdata = NULL, uint16_t dlen = 0, uint8_t dummyBytes = 0);
+	ILI9341_STAT_t startRAMWrite( void );
+	ILI9341_STAT_t continueRAMWrite( uint8_t* pdata, size_t numBytes );
+	ILI9341_STAT_t stopRAMWrite( void );
+	ILI9341_STAT_t waitForBus( void );				// Sends anything still queued
+	ILI9341_STAT_t startBatch( void );
+	ILI9341_STAT_t stopBatch( void );
+	ILI9341_STAT_t transferSPIbuffer(uint8_t* pdata, size_t count, bool arduinoStillBroken );
+};
+
+#endif /* __linux__ */
+#endif /* HPYERDISPLAY_ILI9341_LINUX_H */
@@ -0,0 +1,57 @@
+#include "HyperDisplay_ILI9341_Reader.h"
+
+
+bool ILI9341_Reader::skip( size_t len )
+{
+	uint8_t discard[ILI9341_READER_SKIP_CHUNK];
+	while( len )
+	{
+		size_t chunk = (len > sizeof(discard)) ? sizeof(discard) : len;
+		if( read(discard, chunk) != chunk ){ return false; }
+		len -= chunk;
+	}
+	return true;
+}
+
+bool ILI9341_Reader::rewind( void )
+{
+	return false;
+}
+
+
+
+#if defined(ARDUINO)
+ILI9341_StreamReader::ILI9341_StreamReader( Stream* stream )
+{
+	_stream = stream;
+}
+
+size_t ILI9341_StreamReader::read( uint8_t* buff, size_t len )
+{
+	if( _stream == NULL ){ return 0; }
+	return _stream->readBytes((char*)buff, len);
+}
+#else
+ILI9341_FileReader::ILI9341_FileReader( FILE* file )
+{
+	_file = file;
+}
+
+size_t ILI9341_FileReader::read( uint8_t* buff, size_t len )
+{
+	if( _file == NULL ){ return 0; }
+	return fread(buff, 1, len, _file);
+}
+
+bool ILI9341_FileReader::skip( size_t len )
+{
+	if( _file == NULL ){ return false; }
+	return (fseek(_file, (long)len, SEEK_CUR) == 0);
+}
+
+bool ILI9341_FileReader::rewind( void )
+{
+	if( _file == NULL ){ return false; }
+	return (fseek(_file, 0, SEEK_SET) == 0);
+}
+#endif
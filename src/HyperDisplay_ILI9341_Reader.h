@@ -0,0 +1,74 @@
+/*
+
+Byte readers for HyperDisplay ILI9341 - a tiny interface that the 
+players and decoders pull their data through so they don't care
+whether it comes from an SD card, flash or a file on a host. 
+
+On Arduino anything derived from Stream (SD File, LittleFS File,
+Serial...) can be wrapped with ILI9341_StreamReader. Host builds get 
+ILI9341_FileReader for a stdio FILE. Other sources only need to 
+implement read().
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_READER_H
+#define HPYERDISPLAY_ILI9341_READER_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include <Arduino.h>
+#if !defined(ARDUINO)
+#include <stdio.h>
+#endif
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_READER_SKIP_CHUNK
+#define ILI9341_READER_SKIP_CHUNK 64		// Stack used by the default skip()
+#endif
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_Reader{
+private:
+protected:
+public:
+	virtual ~ILI9341_Reader( void ){}
+
+	virtual size_t read( uint8_t* buff, size_t len ) = 0;		// Returns how many bytes were read, less than len only at the end of the data
+	virtual bool skip( size_t len );							// Default reads and discards, override if the source can seek
+	virtual bool rewind( void );								// Back to the start if the source supports it
+};
+
+#if defined(ARDUINO)
+class ILI9341_StreamReader : public ILI9341_Reader{
+private:
+protected:
+	Stream* _stream;
+
+public:
+	ILI9341_StreamReader( Stream* stream );
+
+	size_t read( uint8_t* buff, size_t len );
+};
+#else
+class ILI9341_FileReader : public ILI9341_Reader{
+private:
+protected:
+	FILE* _file;
+
+public:
+	ILI9341_FileReader( FILE* file );
+
+	size_t read( uint8_t* buff, size_t len );
+	bool skip( size_t len );
+	bool rewind( void );
+};
+#endif
+
+#endif /* HPYERDISPLAY_ILI9341_READER_H */
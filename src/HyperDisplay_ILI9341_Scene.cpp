@@ -0,0 +1,354 @@
+#include "HyperDisplay_ILI9341_Scene.h"
+
+
+static int16_t ILI9341_isqrt( int32_t val )
+{
+	if( val <= 0 ){ return 0; }
+	int32_t root = 0;
+	int32_t bit = (int32_t)1 << 30;
+	while( bit > val ){ bit >>= 2; }
+	while( bit != 0 )
+	{
+		if( val >= root + bit )
+		{
+			val -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (int16_t)root;
+}
+
+ILI9341_Scene::ILI9341_Scene( ILI9341* target )
+{
+	_target = target;
+	_numPrims = 0;
+	memset(_background, 0x00, sizeof(_background));
+}
+
+void ILI9341_Scene::clear( void )
+{
+	_numPrims = 0;
+}
+
+void ILI9341_Scene::setBackground( color_t color )
+{
+	if( color == NULL ){ return; }
+	memcpy(_background, color, _target->getBytesPerPixel());
+}
+
+uint8_t ILI9341_Scene::getNumPrims( void )
+{
+	return _numPrims;
+}
+
+ILI9341_prim_t* ILI9341_Scene::addPrim( ILI9341_PRIM_t type, color_t color )
+{
+	if( _numPrims >= ILI9341_SCENE_MAX_PRIMS ){ return NULL; }
+
+	ILI9341_prim_t* prim = &_prims[_numPrims++];
+	prim->type = type;
+	prim->src = NULL;
+	if( color != NULL ){ memcpy(prim->color, color, _target->getBytesPerPixel()); }
+	return prim;
+}
+
+
+
+// Describing the scene
+ILI9341_STAT_t ILI9341_Scene::fill( int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color )
+{
+	if( color == NULL ){ return ILI9341_STAT_Error; }
+	ILI9341_prim_t* prim = addPrim(ILI9341_PRIM_Fill, color);
+	if( prim == NULL ){ return ILI9341_STAT_Error; }
+
+	prim->bx0 = prim->x0 = (x0 < x1) ? x0 : x1;
+	prim->by0 = prim->y0 = (y0 < y1) ? y0 : y1;
+	prim->bx1 = prim->x1 = (x0 < x1) ? x1 : x0;
+	prim->by1 = prim->y1 = (y0 < y1) ? y1 : y0;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_Scene::rectangle( int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color )
+{
+	ILI9341_STAT_t retval = fill(x0, y0, x1, y1, color);
+	if( retval == ILI9341_STAT_Nominal ){ _prims[_numPrims - 1].type = ILI9341_PRIM_Rect; }
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341_Scene::line( int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color )
+{
+	if( color == NULL ){ return ILI9341_STAT_Error; }
+	ILI9341_prim_t* prim = addPrim(ILI9341_PRIM_Line, color);
+	if( prim == NULL ){ return ILI9341_STAT_Error; }
+
+	// Stored top to bottom so that rasterizing can stop as soon as it passes the band
+	if( y1 < y0 ){ int16_t temp = x0; x0 = x1; x1 = temp; temp = y0; y0 = y1; y1 = temp; }
+	prim->x0 = x0;
+	prim->y0 = y0;
+	prim->x1 = x1;
+	prim->y1 = y1;
+	prim->bx0 = (x0 < x1) ? x0 : x1;
+	prim->bx1 = (x0 < x1) ? x1 : x0;
+	prim->by0 = y0;
+	prim->by1 = y1;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_Scene::circle( int16_t x0, int16_t y0, int16_t radius, color_t color, bool filled )
+{
+	if((color == NULL) || (radius < 0)){ return ILI9341_STAT_Error; }
+	ILI9341_prim_t* prim = addPrim((filled) ? ILI9341_PRIM_FillCircle : ILI9341_PRIM_Circle, color);
+	if( prim == NULL ){ return ILI9341_STAT_Error; }
+
+	prim->x0 = x0;
+	prim->y0 = y0;
+	prim->x1 = radius;
+	prim->bx0 = x0 - radius;
+	prim->by0 = y0 - radius;
+	prim->bx1 = x0 + radius;
+	prim->by1 = y0 + radius;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_Scene::bitmap( int16_t x0, int16_t y0, int16_t width, int16_t height, color_t data )
+{
+	if((data == NULL) || (width <= 0) || (height <= 0)){ return ILI9341_STAT_Error; }
+	ILI9341_prim_t* prim = addPrim(ILI9341_PRIM_Bitmap, NULL);
+	if( prim == NULL ){ return ILI9341_STAT_Error; }
+
+	prim->src = (const uint8_t*)data;
+	prim->bx0 = prim->x0 = x0;
+	prim->by0 = prim->y0 = y0;
+	prim->bx1 = prim->x1 = x0 + (width - 1);
+	prim->by1 = prim->y1 = y0 + (height - 1);
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_Scene::text( int16_t x0, int16_t y0, const char* str, color_t color )
+{
+	if((str == NULL) || (color == NULL)){ return ILI9341_STAT_Error; }
+	ILI9341_prim_t* prim = addPrim(ILI9341_PRIM_Text, color);
+	if( prim == NULL ){ return ILI9341_STAT_Error; }
+
+	// Measure once now so the text can be culled like everything else
+	int16_t width = 0;
+	int16_t height = 0;
+	ILI9341_glyph_t scratch;
+	for(const char* pc = str; (*pc != '\0') && (*pc != '\n'); pc++)
+	{
+		const ILI9341_glyph_t* glyph = _target->getGlyph((uint8_t)*pc, &scratch);
+		width += glyph->width;
+		if( glyph->height > height ){ height = glyph->height; }
+	}
+	prim->src = (const uint8_t*)str;
+	prim->bx0 = prim->x0 = x0;
+	prim->by0 = prim->y0 = y0;
+	prim->bx1 = prim->x1 = x0 + width - 1;
+	prim->by1 = prim->y1 = y0 + height - 1;
+	return ILI9341_STAT_Nominal;
+}
+
+
+
+// Rasterizing
+void ILI9341_Scene::span( uint8_t* row, int16_t x0, int16_t x1, hd_hw_extent_t width, const uint8_t* color, uint8_t bpp )
+{
+	if( x0 < 0 ){ x0 = 0; }
+	if( x1 > (int16_t)(width - 1) ){ x1 = width - 1; }
+	if( x1 < x0 ){ return; }
+
+	// One pixel then keep doubling, the same way the scratch arena fills
+	uint8_t* pdst = row + ((size_t)x0*bpp);
+	size_t total = (size_t)((x1 - x0) + 1)*bpp;
+	memcpy(pdst, color, bpp);
+	size_t filled = bpp;
+	while( filled < total )
+	{
+		size_t copy = ((total - filled) > filled) ? filled : (total - filled);
+		memcpy(pdst + filled, pdst, copy);
+		filled += copy;
+	}
+}
+
+void ILI9341_Scene::drawPrim( const ILI9341_prim_t* prim, uint8_t* band, int16_t y0, int16_t y1, hd_hw_extent_t width, uint8_t bpp )
+{
+	size_t stride = (size_t)width*bpp;
+	int16_t top = (prim->by0 > y0) ? prim->by0 : y0;
+	int16_t bottom = (prim->by1 < y1) ? prim->by1 : y1;
+
+	switch( prim->type )
+	{
+		case ILI9341_PRIM_Fill :
+			for(int16_t y = top; y <= bottom; y++)
+			{
+				span(band + ((y - y0)*stride), prim->x0, prim->x1, width, prim->color, bpp);
+			}
+			break;
+
+		case ILI9341_PRIM_Rect :
+			for(int16_t y = top; y <= bottom; y++)
+			{
+				uint8_t* row = band + ((y - y0)*stride);
+				if((y == prim->y0) || (y == prim->y1))
+				{
+					span(row, prim->x0, prim->x1, width, prim->color, bpp);
+				}
+				else
+				{
+					span(row, prim->x0, prim->x0, width, prim->color, bpp);
+					span(row, prim->x1, prim->x1, width, prim->color, bpp);
+				}
+			}
+			break;
+
+		case ILI9341_PRIM_Line :
+		{
+			// Bresenham from the top end, horizontal runs are written as spans
+			int16_t dx = (prim->x1 > prim->x0) ? (prim->x1 - prim->x0) : (prim->x0 - prim->x1);
+			int16_t dy = prim->y1 - prim->y0;
+			int16_t sx = (prim->x0 < prim->x1) ? 1 : -1;
+			int32_t err = (int32_t)dx - dy;
+			int16_t x = prim->x0;
+			int16_t y = prim->y0;
+			int16_t runStart = x;
+			while( y <= y1 )
+			{
+				bool last = ((x == prim->x1) && (y == prim->y1));
+				int32_t e2 = 2*err;
+				bool stepY = last || (e2 < dx);
+				if( stepY )
+				{
+					if( y >= y0 )
+					{
+						span(band + ((y - y0)*stride), (runStart < x) ? runStart : x, (runStart < x) ? x : runStart, width, prim->color, bpp);
+					}
+					if( last ){ break; }
+				}
+				if( e2 > -dy ){ err -= dy; x += sx; }
+				if( e2 < dx ){ err += dx; y++; runStart = x; }
+			}
+			break;
+		}
+
+		case ILI9341_PRIM_Circle :
+		case ILI9341_PRIM_FillCircle :
+		{
+			int32_t r2 = (int32_t)prim->x1*prim->x1;
+			for(int16_t y = top; y <= bottom; y++)
+			{
+				uint8_t* row = band + ((y - y0)*stride);
+				int16_t dy = (y > prim->y0) ? (y - prim->y0) : (prim->y0 - y);
+				int16_t outer = ILI9341_isqrt(r2 - ((int32_t)dy*dy));
+				if( prim->type == ILI9341_PRIM_FillCircle )
+				{
+					span(row, prim->x0 - outer, prim->x0 + outer, width, prim->color, bpp);
+					continue;
+				}
+				// The outline on each row runs out to where the next row further from the center starts, so it stays connected
+				int16_t inner = (dy < prim->x1) ? ILI9341_isqrt(r2 - ((int32_t)(dy + 1)*(dy + 1))) + 1 : 0;
+				if( inner > outer ){ inner = outer; }
+				span(row, prim->x0 - outer, prim->x0 - inner, width, prim->color, bpp);
+				span(row, prim->x0 + inner, prim->x0 + outer, width, prim->color, bpp);
+			}
+			break;
+		}
+
+		case ILI9341_PRIM_Bitmap :
+		{
+			int16_t left = (prim->x0 < 0) ? 0 : prim->x0;
+			int16_t right = (prim->x1 > (int16_t)(width - 1)) ? (width - 1) : prim->x1;
+			if( right < left ){ break; }
+			size_t srcStride = (size_t)((prim->x1 - prim->x0) + 1)*bpp;
+			for(int16_t y = top; y <= bottom; y++)
+			{
+				const uint8_t* psrc = prim->src + ((y - prim->y0)*srcStride) + ((size_t)(left - prim->x0)*bpp);
+				memcpy(band + ((y - y0)*stride) + ((size_t)left*bpp), psrc, (size_t)((right - left) + 1)*bpp);
+			}
+			break;
+		}
+
+		case ILI9341_PRIM_Text :
+		{
+			ILI9341_glyph_t scratch;
+			int16_t x = prim->x0;
+			for(const char* pc = (const char*)prim->src; (*pc != '\0') && (*pc != '\n') && (x < (int16_t)width); pc++)
+			{
+				const ILI9341_glyph_t* glyph = _target->getGlyph((uint8_t)*pc, &scratch);
+				for(int16_t y = top; y <= bottom; y++)
+				{
+					int16_t gy = y - prim->y0;
+					if( gy >= glyph->height ){ continue; }
+					uint16_t bits = glyph->rows[gy];
+					for(uint8_t col = 0; bits != 0; col++, bits >>= 1)
+					{
+						if( bits & 0x01 ){ span(band + ((y - y0)*stride), x + col, x + col, width, prim->color, bpp); }
+					}
+				}
+				x += glyph->width;
+			}
+			break;
+		}
+
+		default :
+			break;
+	}
+}
+
+void ILI9341_Scene::renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	if((band == NULL) || (rows == 0) || (width == 0) || (bpp == 0)){ return; }
+
+	int16_t top = (int16_t)y0;
+	int16_t bottom = (int16_t)(y0 + (rows - 1));
+	size_t stride = (size_t)width*bpp;
+
+	// Background first, one row then copies of it
+	span(band, 0, width - 1, width, _background, bpp);
+	for(hd_hw_extent_t row = 1; row < rows; row++)
+	{
+		memcpy(band + (row*stride), band, stride);
+	}
+
+	for(uint8_t indi = 0; indi < _numPrims; indi++)
+	{
+		const ILI9341_prim_t* prim = &_prims[indi];
+		if((prim->by1 < top) || (prim->by0 > bottom) || (prim->bx1 < 0) || (prim->bx0 > (int16_t)(width - 1))){ continue; }	// Culled
+		drawPrim(prim, band, top, bottom, width, bpp);
+	}
+}
+
+void ILI9341_Scene::renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, void* context )
+{
+	if( context == NULL ){ return; }
+	((ILI9341_Scene*)context)->renderBand(band, y0, rows, width);
+}
+
+ILI9341_STAT_t ILI9341_Scene::render( uint8_t* buff, size_t size, ILI9341_FrameDiff* diff )
+{
+	uint8_t bpp = _target->getBytesPerPixel();
+	hd_hw_extent_t width = _target->xExt;
+	hd_hw_extent_t height = _target->yExt;
+	if((buff == NULL) || (bpp == 0)){ return ILI9341_STAT_Error; }
+
+	hd_hw_extent_t rowsPerBand = size/((size_t)width*bpp);
+	if( rowsPerBand == 0 ){ return ILI9341_STAT_Error; }
+
+	for(hd_hw_extent_t y0 = 0; y0 < height; y0 += rowsPerBand)
+	{
+		hd_hw_extent_t rows = ((height - y0) < rowsPerBand) ? (height - y0) : rowsPerBand;
+		renderBand(buff, y0, rows, width);
+		if( diff != NULL )
+		{
+			diff->sendBand(buff, y0, rows, width);
+			continue;
+		}
+		_target->hwfillFromArray(0, y0, width - 1, y0 + (rows - 1), (color_t)buff, (hd_pixels_t)width*rows);
+	}
+	return ILI9341_STAT_Nominal;
+}
@@ -0,0 +1,97 @@
+/*
+
+Band renderer for HyperDisplay ILI9341 - the scene is described once
+as a list of primitives and then rasterized a band at a time into a
+small buffer. Each band goes out as a single window, so the result 
+is a full frame with no overdraw on the glass and no flicker, while
+only needing width x rows pixels of RAM. Primitives are culled per 
+band using their bounding boxes.
+
+renderBand also fits ILI9341_band_render_t so a scene can be fed to
+ILI9341_BandPipeline.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_SCENE_H
+#define HPYERDISPLAY_ILI9341_SCENE_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+#include "HyperDisplay_ILI9341_FrameDiff.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_SCENE_MAX_PRIMS
+#define ILI9341_SCENE_MAX_PRIMS 32
+#endif
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef enum{
+	ILI9341_PRIM_Fill = 0x00,		// Filled rectangle
+	ILI9341_PRIM_Rect,				// Rectangle outline
+	ILI9341_PRIM_Line,
+	ILI9341_PRIM_Circle,			// Circle outline
+	ILI9341_PRIM_FillCircle,
+	ILI9341_PRIM_Bitmap,			// Pixel array in the display's format
+	ILI9341_PRIM_Text				// Transparent text using the display's font
+}ILI9341_PRIM_t;
+
+typedef struct ILI9341_prim{
+	ILI9341_PRIM_t type;
+	int16_t x0;						// Geometry - circles use x0, y0 as the center and x1 as the radius
+	int16_t y0;
+	int16_t x1;
+	int16_t y1;
+	int16_t bx0;					// Inclusive bounding box used to cull the primitive from bands it can't touch
+	int16_t by0;
+	int16_t bx1;
+	int16_t by1;
+	const uint8_t* src;				// Bitmap pixels or text, must stay valid until the scene is rendered
+	uint8_t color[ILI9341_MAX_BPP];
+}ILI9341_prim_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_Scene{
+private:
+protected:
+	ILI9341* _target;
+	ILI9341_prim_t _prims[ILI9341_SCENE_MAX_PRIMS];
+	uint8_t _numPrims;
+	uint8_t _background[ILI9341_MAX_BPP];
+
+	ILI9341_prim_t* addPrim( ILI9341_PRIM_t type, color_t color );
+	void span( uint8_t* row, int16_t x0, int16_t x1, hd_hw_extent_t width, const uint8_t* color, uint8_t bpp );
+	void drawPrim( const ILI9341_prim_t* prim, uint8_t* band, int16_t y0, int16_t y1, hd_hw_extent_t width, uint8_t bpp );
+
+public:
+	ILI9341_Scene( ILI9341* target );
+
+	void clear( void );
+	void setBackground( color_t color );
+	uint8_t getNumPrims( void );
+
+	// Describing the scene - primitives are drawn in the order they are added
+	ILI9341_STAT_t fill( int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color );
+	ILI9341_STAT_t rectangle( int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color );
+	ILI9341_STAT_t line( int16_t x0, int16_t y0, int16_t x1, int16_t y1, color_t color );
+	ILI9341_STAT_t circle( int16_t x0, int16_t y0, int16_t radius, color_t color, bool filled = false );
+	ILI9341_STAT_t bitmap( int16_t x0, int16_t y0, int16_t width, int16_t height, color_t data );
+	ILI9341_STAT_t text( int16_t x0, int16_t y0, const char* str, color_t color );
+
+	// Rasterizing
+	void renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width );
+	static void renderBand( uint8_t* band, hd_hw_extent_t y0, hd_hw_extent_t rows, hd_hw_extent_t width, void* context );	// ILI9341_band_render_t, context is the scene
+	ILI9341_STAT_t render( uint8_t* buff, size_t size, ILI9341_FrameDiff* diff = NULL );	// Whole screen, as many rows per band as fit in buff. With diff only changed spans are sent
+};
+
+#endif /* HPYERDISPLAY_ILI9341_SCENE_H */
@@ -0,0 +1,190 @@
+#include "HyperDisplay_ILI9341_StripChart.h"
+
+
+ILI9341_StripChart::ILI9341_StripChart( ILI9341* target )
+{
+	_target = target;
+	_running = false;
+	_reversed = false;
+	_x0 = 0;
+	_x1 = 0;
+	_tfa = 0;
+	_vsa = ILI9341_MAX_Y;
+	_ssa = 0;
+	_min = 0;
+	_max = 1;
+	_gridSamples = 0;
+	_gridPixels = 0;
+	_samples = 0;
+	_bpp = 0;
+	_numTraces = 0;
+	for(uint8_t indi = 0; indi < ILI9341_CHART_MAX_TRACES; indi++){ _lastY[indi] = ILI9341_CHART_NO_Y; }
+}
+
+ILI9341_STAT_t ILI9341_StripChart::setColors( color_t background, color_t grid )
+{
+	_bpp = _target->getBytesPerPixel();
+	if((background == NULL) || (grid == NULL) || (_bpp == 0)){ _bpp = 0; return ILI9341_STAT_Error; }
+	memcpy(_background, background, _bpp);
+	memcpy(_grid, grid, _bpp);
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_StripChart::setTrace( uint8_t index, color_t color )
+{
+	if((index >= ILI9341_CHART_MAX_TRACES) || (color == NULL) || (_bpp == 0)){ return ILI9341_STAT_Error; }
+	memcpy(_traceColors + (index*_bpp), color, _bpp);
+	if( index >= _numTraces ){ _numTraces = index + 1; }
+	_lastY[index] = ILI9341_CHART_NO_Y;
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_StripChart::setRange( int32_t min, int32_t max )
+{
+	if( min == max ){ max = min + 1; }
+	_min = (min < max) ? min : max;
+	_max = (min < max) ? max : min;
+}
+
+void ILI9341_StripChart::setGrid( uint16_t everySamples, uint16_t everyPixels )
+{
+	_gridSamples = everySamples;
+	_gridPixels = everyPixels;
+}
+
+uint32_t ILI9341_StripChart::getSampleCount( void )
+{
+	return _samples;
+}
+
+
+
+// Scrolling
+ILI9341_STAT_t ILI9341_StripChart::begin( hd_hw_extent_t x0, hd_hw_extent_t x1 )
+{
+	// Rotation 270 is MV alone, so logical x is the memory row. Rotation 90 adds MY which turns it around
+	uint16_t rotation = _target->getRotation();
+	if((rotation != 90) && (rotation != 270)){ return ILI9341_STAT_Error; }
+	if( x1 < x0 ){ hd_hw_extent_t temp = x0; x0 = x1; x1 = temp; }
+	if( x1 >= ILI9341_MAX_Y ){ x1 = ILI9341_MAX_Y - 1; }
+	if( x0 > x1 ){ return ILI9341_STAT_Error; }
+
+	_reversed = (rotation == 90);
+	_x0 = x0;
+	_x1 = x1;
+	_vsa = (x1 - x0) + 1;
+	_tfa = _reversed ? ((ILI9341_MAX_Y - 1) - x1) : x0;
+	_ssa = _tfa;
+
+	ILI9341_STAT_t retval = _target->setVerticalScrolling(_tfa, _vsa, ILI9341_MAX_Y - (_tfa + _vsa));
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	retval = _target->setVerticalScrollingStartAddress(_ssa);
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	_running = true;
+	return clear();
+}
+
+ILI9341_STAT_t ILI9341_StripChart::end( void )
+{
+	if( !_running ){ return ILI9341_STAT_Nominal; }
+	_running = false;
+	ILI9341_STAT_t retval = _target->setVerticalScrolling(0, ILI9341_MAX_Y, 0);
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+	return _target->setVerticalScrollingStartAddress(0);
+}
+
+ILI9341_STAT_t ILI9341_StripChart::clear( void )
+{
+	if( !_running || (_bpp == 0) || (_bpp != _target->getBytesPerPixel()) ){ return ILI9341_STAT_Error; }
+
+	// Every memory row in the chart looks the same, so the scroll position doesn't matter here
+	hd_hw_extent_t height = _target->yExt;
+	_target->startBatch();
+	_target->hwrectangle(_x0, 0, _x1, height - 1, true, (color_t)_background);
+	if( _gridPixels != 0 )
+	{
+		for(hd_hw_extent_t y = 0; y < height; y += _gridPixels){ _target->hwxline(_x0, y, _vsa, (color_t)_grid); }
+	}
+	_target->stopBatch();
+
+	_samples = 0;
+	for(uint8_t indi = 0; indi < ILI9341_CHART_MAX_TRACES; indi++){ _lastY[indi] = ILI9341_CHART_NO_Y; }
+	return ILI9341_STAT_Nominal;
+}
+
+
+
+// Samples
+hd_hw_extent_t ILI9341_StripChart::valueToY( int32_t value )
+{
+	hd_hw_extent_t height = _target->yExt;
+	if( value <= _min ){ return height - 1; }
+	if( value >= _max ){ return 0; }
+	int64_t offset = ((int64_t)(_max - value)*(height - 1))/((int64_t)_max - _min);
+	return (hd_hw_extent_t)offset;
+}
+
+void ILI9341_StripChart::paint( hd_hw_extent_t y0, hd_hw_extent_t y1, const uint8_t* color )
+{
+	if( y1 < y0 ){ hd_hw_extent_t temp = y0; y0 = y1; y1 = temp; }
+	uint8_t* pdst = _column + ((size_t)y0*_bpp);
+	for(hd_hw_extent_t y = y0; y <= y1; y++, pdst += _bpp){ memcpy(pdst, color, _bpp); }
+}
+
+ILI9341_STAT_t ILI9341_StripChart::addSample( const int32_t* values, uint8_t numValues )
+{
+	if( !_running || (_bpp == 0) || (_bpp != _target->getBytesPerPixel()) ){ return ILI9341_STAT_Error; }
+	if((values == NULL) && (numValues != 0)){ return ILI9341_STAT_Error; }
+	hd_hw_extent_t height = _target->yExt;
+	if( height > ILI9341_MAX_Y ){ height = ILI9341_MAX_Y; }
+
+	// Build the whole column first - background, then grid, then the traces on top
+	if((_gridSamples != 0) && ((_samples % _gridSamples) == 0))
+	{
+		paint(0, height - 1, _grid);
+	}
+	else
+	{
+		paint(0, height - 1, _background);
+		if( _gridPixels != 0 )
+		{
+			for(hd_hw_extent_t y = 0; y < height; y += _gridPixels){ memcpy(_column + ((size_t)y*_bpp), _grid, _bpp); }
+		}
+	}
+	for(uint8_t indi = 0; (indi < numValues) && (indi < _numTraces); indi++)
+	{
+		hd_hw_extent_t y = valueToY(values[indi]);
+		hd_hw_extent_t from = (_lastY[indi] == ILI9341_CHART_NO_Y) ? y : _lastY[indi];	// Join up with the last sample so steep edges stay solid
+		paint(from, y, _traceColors + (indi*_bpp));
+		_lastY[indi] = y;
+	}
+
+	// The row at the old end of the scroll area is recycled for the new sample, then the scroll brings it round to the right hand edge
+	uint16_t row = _ssa;
+	uint16_t next = _ssa;
+	if( _reversed )
+	{
+		row = (_ssa == _tfa) ? (_tfa + (_vsa - 1)) : (_ssa - 1);
+		next = row;
+	}
+	else
+	{
+		next = (_ssa == _tfa + (_vsa - 1)) ? _tfa : (_ssa + 1);
+	}
+	hd_hw_extent_t x = _reversed ? ((ILI9341_MAX_Y - 1) - row) : row;
+
+	_target->startBatch();
+	_target->hwyline(x, 0, height, (color_t)_column, height, 0, false);
+	ILI9341_STAT_t retval = _target->setVerticalScrollingStartAddress(next);
+	_target->stopBatch();
+	if( retval != ILI9341_STAT_Nominal ){ return retval; }
+
+	_ssa = next;
+	_samples++;
+	return ILI9341_STAT_Nominal;
+}
+
+ILI9341_STAT_t ILI9341_StripChart::addSample( int32_t value )
+{
+	return addSample(&value, 1);
+}
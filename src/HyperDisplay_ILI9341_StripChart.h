@@ -0,0 +1,88 @@
+/*
+
+Strip chart for HyperDisplay ILI9341 - live traces that move along
+the time axis using the controller's vertical scrolling instead of
+redrawing. Each sample draws exactly one new column (background, grid
+and every trace together) as a single hwyline, then moves the scroll
+start address on by one so the whole chart shifts without a pixel of
+it being sent again.
+
+The ILI9341 only scrolls along the long side of the panel, so the
+chart needs a landscape rotation (90 or 270) where that side is the x
+axis. The columns left and right of the chart become the fixed areas,
+and anything drawn there (axis labels, scale markings) stays put. New
+samples always come in at the right hand edge.
+
+Memory rows inside the chart are rotated by the scroll, so don't draw
+into the chart area directly while it is running - call end() first,
+and redraw afterwards.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_STRIPCHART_H
+#define HPYERDISPLAY_ILI9341_STRIPCHART_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#define ILI9341_CHART_MAX_TRACES 4
+#define ILI9341_CHART_NO_Y 0xFFFF			// A trace that hasn't had a sample yet
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_StripChart{
+private:
+protected:
+	ILI9341* _target;
+	bool _running;
+	bool _reversed;				// Logical x runs against memory rows (rotation 90), so the scroll runs backwards
+	hd_hw_extent_t _x0;			// Logical columns of the chart
+	hd_hw_extent_t _x1;
+	uint16_t _tfa;				// Scrolling area in memory rows
+	uint16_t _vsa;
+	uint16_t _ssa;
+
+	int32_t _min;
+	int32_t _max;
+	uint16_t _gridSamples;		// Vertical grid line every this many samples, 0 for none
+	uint16_t _gridPixels;		// Horizontal grid line every this many pixels from the top, 0 for none
+	uint32_t _samples;
+
+	uint8_t _bpp;
+	uint8_t _background[ILI9341_MAX_BPP];
+	uint8_t _grid[ILI9341_MAX_BPP];
+	uint8_t _traceColors[ILI9341_CHART_MAX_TRACES*ILI9341_MAX_BPP];
+	uint8_t _numTraces;
+	hd_hw_extent_t _lastY[ILI9341_CHART_MAX_TRACES];
+
+	uint8_t _column[ILI9341_MAX_Y*ILI9341_MAX_BPP];		// One column, in the caller's color order
+
+	hd_hw_extent_t valueToY( int32_t value );
+	void paint( hd_hw_extent_t y0, hd_hw_extent_t y1, const uint8_t* color );
+
+public:
+	ILI9341_StripChart( ILI9341* target );
+
+	ILI9341_STAT_t setColors( color_t background, color_t grid );		// Copied, call again after changing the pixel format
+	ILI9341_STAT_t setTrace( uint8_t index, color_t color );			// Traces 0 to index are drawn
+	void setRange( int32_t min, int32_t max );							// min at the bottom of the chart, max at the top
+	void setGrid( uint16_t everySamples, uint16_t everyPixels );
+
+	ILI9341_STAT_t begin( hd_hw_extent_t x0, hd_hw_extent_t x1 );		// Logical columns to scroll, the rest of the screen is fixed
+	ILI9341_STAT_t clear( void );										// Background and grid over the whole chart
+	ILI9341_STAT_t addSample( const int32_t* values, uint8_t numValues );	// One value per trace
+	ILI9341_STAT_t addSample( int32_t value );
+	ILI9341_STAT_t end( void );											// Back to an unscrolled screen, the chart area is left scrambled
+
+	uint32_t getSampleCount( void );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_STRIPCHART_H */
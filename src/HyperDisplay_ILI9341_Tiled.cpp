@@ -0,0 +1,216 @@
+#include "HyperDisplay_ILI9341_Tiled.h"
+
+
+ILI9341_Tiled::ILI9341_Tiled(uint16_t xSize, uint16_t ySize) : hyperdisplay(xSize, ySize)
+{
+	_numTiles = 0;
+	_lastPanel = NULL;
+}
+
+ILI9341_STAT_t ILI9341_Tiled::addPanel( ILI9341* panel, hd_hw_extent_t x0, hd_hw_extent_t y0 )
+{
+	if( panel == NULL ){ return ILI9341_STAT_Error; }
+	if( _numTiles >= ILI9341_TILED_MAX_PANELS ){ return ILI9341_STAT_Error; }
+
+	_tiles[_numTiles].panel = panel;
+	_tiles[_numTiles].x0 = x0;
+	_tiles[_numTiles].y0 = y0;
+	_numTiles++;
+	return ILI9341_STAT_Nominal;
+}
+
+uint8_t ILI9341_Tiled::getNumPanels( void )
+{
+	return _numTiles;
+}
+
+bool ILI9341_Tiled::clipToTile( const ILI9341_tile_t* tile, hd_hw_extent_t* x0, hd_hw_extent_t* y0, hd_hw_extent_t* x1, hd_hw_extent_t* y1 )
+{
+	hd_hw_extent_t tx1 = tile->x0 + (tile->panel->xExt - 1);
+	hd_hw_extent_t ty1 = tile->y0 + (tile->panel->yExt - 1);
+
+	if((*x1 < tile->x0) || (*x0 > tx1) || (*y1 < tile->y0) || (*y0 > ty1)){ return false; }
+	if( *x0 < tile->x0 ){ *x0 = tile->x0; }
+	if( *y0 < tile->y0 ){ *y0 = tile->y0; }
+	if( *x1 > tx1 ){ *x1 = tx1; }
+	if( *y1 > ty1 ){ *y1 = ty1; }
+	return true;
+}
+
+ILI9341* ILI9341_Tiled::usePanel( uint8_t tile )
+{
+	// The panels share a bus - the next piece has already been worked out, now it has to wait for the last one to finish
+	ILI9341* panel = _tiles[tile].panel;
+	if( (_lastPanel != NULL) && (_lastPanel != panel) ){ _lastPanel->waitForBus(); }
+	_lastPanel = panel;
+	return panel;
+}
+
+
+
+// Pure virtual functions from HyperDisplay Implemented:
+color_t ILI9341_Tiled::getOffsetColor(color_t base, uint32_t numPixels)
+{
+	if( _numTiles == 0 ){ return base; }
+	return _tiles[0].panel->getOffsetColor(base, numPixels);
+}
+
+void 	ILI9341_Tiled::hwpixel(hd_hw_extent_t x0, hd_hw_extent_t y0, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset)
+{
+	if(data == NULL){ return; }
+
+	for(uint8_t indi = 0; indi < _numTiles; indi++)
+	{
+		hd_hw_extent_t xa = x0, ya = y0, xb = x0, yb = y0;
+		if( !clipToTile(&_tiles[indi], &xa, &ya, &xb, &yb) ){ continue; }
+		usePanel(indi)->hwpixel(x0 - _tiles[indi].x0, y0 - _tiles[indi].y0, data, colorCycleLength, startColorOffset);
+		return;
+	}
+}
+
+void 	ILI9341_Tiled::hwxline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t len, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool goLeft)
+{
+	if(data == NULL){ return; }
+	if( len < 1 ){ return; }
+
+	// Going left the line covers x0 back to x0 - (len - 1)
+	hd_hw_extent_t xa = x0;
+	hd_hw_extent_t xb = x0 + (len - 1);
+	if( goLeft )
+	{
+		xa = (x0 >= (len - 1)) ? (x0 - (len - 1)) : 0;
+		xb = x0;
+	}
+
+	for(uint8_t indi = 0; indi < _numTiles; indi++)
+	{
+		hd_hw_extent_t a = xa, b = xb, ya = y0, yb = y0;
+		if( !clipToTile(&_tiles[indi], &a, &ya, &b, &yb) ){ continue; }
+
+		// Each piece picks the color cycle up from wherever the line had got to at its first pixel
+		hd_hw_extent_t first = (goLeft) ? b : a;
+		hd_pixels_t skipped = (goLeft) ? (x0 - b) : (a - x0);
+		hd_colors_t offset = getNewColorOffset(colorCycleLength, startColorOffset, skipped);
+		usePanel(indi)->hwxline(first - _tiles[indi].x0, y0 - _tiles[indi].y0, (b - a) + 1, data, colorCycleLength, offset, goLeft);
+	}
+}
+
+void    ILI9341_Tiled::hwyline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t len, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool goUp)
+{
+	if(data == NULL){ return; }
+	if( len < 1 ){ return; }
+
+	hd_hw_extent_t ya = y0;
+	hd_hw_extent_t yb = y0 + (len - 1);
+	if( goUp )
+	{
+		ya = (y0 >= (len - 1)) ? (y0 - (len - 1)) : 0;
+		yb = y0;
+	}
+
+	for(uint8_t indi = 0; indi < _numTiles; indi++)
+	{
+		hd_hw_extent_t a = ya, b = yb, xa = x0, xb = x0;
+		if( !clipToTile(&_tiles[indi], &xa, &a, &xb, &b) ){ continue; }
+
+		hd_hw_extent_t first = (goUp) ? b : a;
+		hd_pixels_t skipped = (goUp) ? (y0 - b) : (a - y0);
+		hd_colors_t offset = getNewColorOffset(colorCycleLength, startColorOffset, skipped);
+		usePanel(indi)->hwyline(x0 - _tiles[indi].x0, first - _tiles[indi].y0, (b - a) + 1, data, colorCycleLength, offset, goUp);
+	}
+}
+
+void 	ILI9341_Tiled::hwrectangle(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, bool filled, color_t data, hd_colors_t colorCycleLength, hd_colors_t startColorOffset, bool reverseGradient, bool gradientVertical)
+{
+	if(data == NULL){ return; }
+
+	// Outlines and gradients are built by HyperDisplay from our hwxline and hwyline, which already split at the seams
+	if( !filled || (colorCycleLength != 1) )
+	{
+		hyperdisplay::hwrectangle(x0, y0, x1, y1, filled, data, colorCycleLength, startColorOffset, reverseGradient, gradientVertical);
+		return;
+	}
+
+	if( x0 > x1 ){ hd_hw_extent_t temp = x0; x0 = x1; x1 = temp; }
+	if( y0 > y1 ){ hd_hw_extent_t temp = y0; y0 = y1; y1 = temp; }
+
+	for(uint8_t indi = 0; indi < _numTiles; indi++)
+	{
+		hd_hw_extent_t xa = x0, ya = y0, xb = x1, yb = y1;
+		if( !clipToTile(&_tiles[indi], &xa, &ya, &xb, &yb) ){ continue; }
+
+		hd_hw_extent_t tx = _tiles[indi].x0;
+		hd_hw_extent_t ty = _tiles[indi].y0;
+		usePanel(indi)->hwrectangle(xa - tx, ya - ty, xb - tx, yb - ty, true, data, 1, 0, reverseGradient, gradientVertical);
+	}
+}
+
+void 	ILI9341_Tiled::hwfillFromArray(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data, hd_pixels_t numPixels, bool Vh)
+{
+	if(numPixels == 0){ return; }
+	if(data == NULL ){ return; }
+
+	hd_pixels_t w = (x1 - x0) + 1;
+	hd_pixels_t h = (y1 - y0) + 1;
+
+	for(uint8_t indi = 0; indi < _numTiles; indi++)
+	{
+		hd_hw_extent_t xa = x0, ya = y0, xb = x1, yb = y1;
+		if( !clipToTile(&_tiles[indi], &xa, &ya, &xb, &yb) ){ continue; }
+
+		ILI9341* panel = usePanel(indi);
+		hd_hw_extent_t tx = _tiles[indi].x0;
+		hd_hw_extent_t ty = _tiles[indi].y0;
+
+		if( !Vh )
+		{
+			if((xa == x0) && (xb == x1))
+			{
+				// Whole rows are contiguous in the source so the panel can take them straight from it
+				hd_pixels_t offset = (ya - y0)*w;
+				if( offset >= numPixels ){ continue; }
+				hd_pixels_t count = ((yb - ya) + 1)*w;
+				if( count > (numPixels - offset) ){ count = numPixels - offset; }
+				panel->hwfillFromArray(xa - tx, ya - ty, xb - tx, yb - ty, getOffsetColor(data, offset), count, false);
+			}
+			else
+			{
+				// Otherwise stream each row's slice into a single window
+				panel->setWindow(xa - tx, ya - ty, xb - tx, yb - ty);
+				panel->startRAMWrite();
+				for(hd_hw_extent_t row = ya; row <= yb; row++)
+				{
+					hd_pixels_t offset = ((row - y0)*w) + (xa - x0);
+					if( offset >= numPixels ){ break; }
+					hd_pixels_t count = (xb - xa) + 1;
+					if( count > (numPixels - offset) ){ count = numPixels - offset; }
+					panel->continuePixelWrite((const uint8_t*)getOffsetColor(data, offset), count);
+				}
+				panel->stopRAMWrite();
+			}
+		}
+		else
+		{
+			if((ya == y0) && (yb == y1))
+			{
+				hd_pixels_t offset = (xa - x0)*h;
+				if( offset >= numPixels ){ continue; }
+				hd_pixels_t count = ((xb - xa) + 1)*h;
+				if( count > (numPixels - offset) ){ count = numPixels - offset; }
+				panel->hwfillFromArray(xa - tx, ya - ty, xb - tx, yb - ty, getOffsetColor(data, offset), count, true);
+			}
+			else
+			{
+				// Column slices are contiguous - a one column window fills top to bottom without touching MADCTL
+				for(hd_hw_extent_t col = xa; col <= xb; col++)
+				{
+					hd_pixels_t offset = ((col - x0)*h) + (ya - y0);
+					if( offset >= numPixels ){ break; }
+					hd_pixels_t count = (yb - ya) + 1;
+					if( count > (numPixels - offset) ){ count = numPixels - offset; }
+					panel->hwfillFromArray(col - tx, ya - ty, col - tx, yb - ty, getOffsetColor(data, offset), count, false);
+				}
+			}
+		}
+	}
+}
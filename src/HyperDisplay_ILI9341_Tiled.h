@@ -0,0 +1,67 @@
+/*
+
+Tiled compositor for HyperDisplay ILI9341 - presents several panels
+that share one bus (each with its own CS) as a single large canvas.
+Every primitive is split at the panel boundaries and each piece is 
+sent to its panel as one window, so nothing crossing a seam falls
+back to per-pixel drawing.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_TILED_H
+#define HPYERDISPLAY_ILI9341_TILED_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+#ifndef ILI9341_TILED_MAX_PANELS
+#define ILI9341_TILED_MAX_PANELS 4
+#endif
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef struct ILI9341_tile{
+	ILI9341* panel;
+	hd_hw_extent_t x0;		// Canvas location of the panel's top-left pixel
+	hd_hw_extent_t y0;
+}ILI9341_tile_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_Tiled : virtual public hyperdisplay{
+private:
+protected:
+	ILI9341_tile_t _tiles[ILI9341_TILED_MAX_PANELS];
+	uint8_t _numTiles;
+	ILI9341* _lastPanel;		// Panel that used the bus most recently
+
+	bool clipToTile( const ILI9341_tile_t* tile, hd_hw_extent_t* x0, hd_hw_extent_t* y0, hd_hw_extent_t* x1, hd_hw_extent_t* y1 );
+	ILI9341* usePanel( uint8_t tile );
+
+public:
+	ILI9341_Tiled(uint16_t xSize, uint16_t ySize);	// Size of the whole canvas
+
+	ILI9341_STAT_t addPanel( ILI9341* panel, hd_hw_extent_t x0, hd_hw_extent_t y0 );	// All panels must use the same pixel format
+	uint8_t getNumPanels( void );
+
+	// Pure virtual functions from HyperDisplay Implemented:
+	color_t getOffsetColor(color_t base, uint32_t numPixels);
+	void 	hwpixel(hd_hw_extent_t x0, hd_hw_extent_t y0, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0);
+
+	void 	hwxline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t len, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool goLeft = false);
+	void    hwyline(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t len, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool goUp = false);
+	void 	hwrectangle(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, bool filled = false, color_t data = NULL, hd_colors_t colorCycleLength = 1, hd_colors_t startColorOffset = 0, bool reverseGradient = false, bool gradientVertical = false); 
+	void 	hwfillFromArray(hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t x1, hd_hw_extent_t y1, color_t data = NULL, hd_pixels_t numPixels = 0, bool Vh = false);
+};
+
+#endif /* HPYERDISPLAY_ILI9341_TILED_H */
@@ -0,0 +1,182 @@
+#include "HyperDisplay_ILI9341_VideoPlayer.h"
+
+
+ILI9341_VideoPlayer::ILI9341_VideoPlayer( ILI9341* target, ILI9341_Reader* reader, uint8_t* memory, size_t size )
+{
+	_target = target;
+	_reader = reader;
+
+	// Two buffers, each a whole number of pixels
+	uint8_t bpp = _target->getBytesPerPixel();
+	_bufferSize = (bpp == 0) ? 0 : (((size/2)/bpp)*bpp);
+	if( memory == NULL ){ _bufferSize = 0; }
+	_buffers[0] = memory;
+	_buffers[1] = (memory == NULL) ? NULL : (memory + _bufferSize);
+
+	_x0 = 0;
+	_y0 = 0;
+	_width = _target->xExt;
+	_height = _target->yExt;
+	_framePeriod = 0;
+	_loop = false;
+	restart();
+	resetStats();
+}
+
+ILI9341_STAT_t ILI9341_VideoPlayer::setRegion( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t width, hd_hw_extent_t height )
+{
+	if((width == 0) || (height == 0)){ return ILI9341_STAT_Error; }
+	if(((x0 + width) > _target->xExt) || ((y0 + height) > _target->yExt)){ return ILI9341_STAT_Error; }
+
+	_x0 = x0;
+	_y0 = y0;
+	_width = width;
+	_height = height;
+	return ILI9341_STAT_Nominal;
+}
+
+void ILI9341_VideoPlayer::setFrameRate( uint16_t fps )
+{
+	_framePeriod = (fps == 0) ? 0 : (1000000UL/fps);
+	restart();
+}
+
+void ILI9341_VideoPlayer::setLoop( bool loop )
+{
+	_loop = loop;
+}
+
+void ILI9341_VideoPlayer::restart( void )
+{
+	_started = false;
+}
+
+size_t ILI9341_VideoPlayer::getFrameBytes( void )
+{
+	return (size_t)_width*_height*_target->getBytesPerPixel();
+}
+
+bool ILI9341_VideoPlayer::nextFrameAvailable( size_t len )
+{
+	// Fills the first buffer with the start of the next frame, rewinding once if looping
+	for(uint8_t attempt = 0; attempt < 2; attempt++)
+	{
+		if( _reader->read(_buffers[0], len) == len ){ return true; }
+		if((!_loop) || (!_reader->rewind())){ return false; }
+	}
+	return false;
+}
+
+ILI9341_STAT_t ILI9341_VideoPlayer::streamFrame( void )
+{
+	size_t remaining = getFrameBytes();
+	size_t len = (remaining < _bufferSize) ? remaining : _bufferSize;
+
+	uint32_t mark = micros();
+	bool ok = nextFrameAvailable(len);
+	uint32_t now = micros();
+	_stats.ioMicros += (now - mark);
+	if( !ok ){ return ILI9341_STAT_Error; }
+
+	_target->setWindow(_x0, _y0, _x0 + (_width - 1), _y0 + (_height - 1));
+	_target->startRAMWrite();
+
+	ILI9341_STAT_t retval = ILI9341_STAT_Nominal;
+	uint8_t current = 0;
+	while( remaining )
+	{
+		// Hand the current buffer to the bus then refill the other one while it goes out
+		mark = micros();
+		_target->continueRAMWrite(_buffers[current], len);
+		now = micros();
+		_stats.busMicros += (now - mark);
+		remaining -= len;
+		if( remaining == 0 ){ break; }
+
+		size_t next = (remaining < _bufferSize) ? remaining : _bufferSize;
+		mark = now;
+		size_t got = _reader->read(_buffers[current ^ 0x01], next);
+		now = micros();
+		_stats.ioMicros += (now - mark);
+
+		mark = now;
+		_target->waitForBus();
+		_stats.busMicros += (micros() - mark);
+
+		if( got != next ){ retval = ILI9341_STAT_Error; break; }		// Truncated frame
+		current ^= 0x01;
+		len = next;
+	}
+
+	mark = micros();
+	_target->waitForBus();
+	_target->stopRAMWrite();
+	_stats.busMicros += (micros() - mark);
+	return retval;
+}
+
+ILI9341_STAT_t ILI9341_VideoPlayer::showFrame( void )
+{
+	if((_reader == NULL) || (_bufferSize == 0) || (getFrameBytes() == 0)){ return ILI9341_STAT_Error; }
+
+	uint32_t start = micros();
+	if( !_started )
+	{
+		_nextDue = start;
+		_started = true;
+	}
+
+	if( _framePeriod != 0 )
+	{
+		// Drop whole frames while more than one period behind
+		while((int32_t)(start - _nextDue) >= (int32_t)_framePeriod)
+		{
+			uint32_t mark = micros();
+			bool ok = _reader->skip(getFrameBytes());
+			_stats.ioMicros += (micros() - mark);
+			if( !ok ){ return ILI9341_STAT_Error; }
+			_stats.skipped++;
+			_nextDue += _framePeriod;
+		}
+
+		// And wait when ahead
+		while((int32_t)(micros() - _nextDue) < 0){}
+		uint32_t due = micros();
+		_stats.idleMicros += (due - start);
+		_stats.elapsedMicros += (due - start);
+		start = due;
+		_nextDue += _framePeriod;
+	}
+
+	ILI9341_STAT_t retval = streamFrame();
+	_stats.elapsedMicros += (micros() - start);
+	if( retval == ILI9341_STAT_Nominal ){ _stats.frames++; }
+	return retval;
+}
+
+uint32_t ILI9341_VideoPlayer::play( uint32_t numFrames )
+{
+	uint32_t shown = 0;
+	while((numFrames == 0) || (shown < numFrames))
+	{
+		if( showFrame() != ILI9341_STAT_Nominal ){ break; }
+		shown++;
+	}
+	return shown;
+}
+
+float ILI9341_VideoPlayer::getFps( void )
+{
+	if( _stats.elapsedMicros == 0 ){ return 0.0; }
+	return ((float)_stats.frames*1000000.0)/_stats.elapsedMicros;
+}
+
+ILI9341_video_stats_t ILI9341_VideoPlayer::getStats( void )
+{
+	return _stats;
+}
+
+void ILI9341_VideoPlayer::resetStats( void )
+{
+	memset(&_stats, 0x00, sizeof(_stats));
+}
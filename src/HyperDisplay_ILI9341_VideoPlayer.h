@@ -0,0 +1,89 @@
+/*
+
+Frame sequence player for HyperDisplay ILI9341 - plays raw frames
+that were converted ahead of time to the display's pixel format (big
+endian 565 for the default 16 bit mode), read through an 
+ILI9341_Reader. Every frame goes out through a single window covering
+the playback region, which can be the whole screen or a smaller
+rectangle for animations.
+
+The memory handed to the player is split into two buffers. While one
+is being sent the other is refilled from the reader. On backends that
+finish transfers in the background (DMA) the read overlaps the bus,
+otherwise they take turns. Given a target frame rate the player 
+skips frames when it falls behind, and it keeps track of the
+achieved rate and of how much time went to I/O and to the bus.
+
+*/
+
+#ifndef HPYERDISPLAY_ILI9341_VIDEOPLAYER_H
+#define HPYERDISPLAY_ILI9341_VIDEOPLAYER_H
+
+
+////////////////////////////////////////////////////////////
+//							Includes    				  //
+////////////////////////////////////////////////////////////
+#include "HyperDisplay_ILI9341.h"
+#include "HyperDisplay_ILI9341_Reader.h"
+
+////////////////////////////////////////////////////////////
+//							Defines     				  //
+////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////
+//							Typedefs    				  //
+////////////////////////////////////////////////////////////
+typedef struct ILI9341_video_stats{
+	uint32_t frames;				// Frames shown
+	uint32_t skipped;				// Frames dropped to hold the frame rate
+	uint32_t ioMicros;				// Waiting on the reader
+	uint32_t busMicros;				// Sending and waiting for the bus
+	uint32_t idleMicros;			// Waiting for the next frame to be due
+	uint32_t elapsedMicros;			// Wall time across all frames
+}ILI9341_video_stats_t;
+
+
+////////////////////////////////////////////////////////////
+//					 Class Definition   				  //
+////////////////////////////////////////////////////////////
+class ILI9341_VideoPlayer{
+private:
+protected:
+	ILI9341* _target;
+	ILI9341_Reader* _reader;
+	uint8_t* _buffers[2];
+	size_t _bufferSize;
+
+	hd_hw_extent_t _x0;
+	hd_hw_extent_t _y0;
+	hd_hw_extent_t _width;
+	hd_hw_extent_t _height;
+
+	uint32_t _framePeriod;			// Microseconds, 0 plays as fast as possible
+	uint32_t _nextDue;
+	bool _started;
+	bool _loop;
+	ILI9341_video_stats_t _stats;
+
+	size_t getFrameBytes( void );
+	bool nextFrameAvailable( size_t len );
+	ILI9341_STAT_t streamFrame( void );
+
+public:
+	ILI9341_VideoPlayer( ILI9341* target, ILI9341_Reader* reader, uint8_t* memory, size_t size );
+
+	ILI9341_STAT_t setRegion( hd_hw_extent_t x0, hd_hw_extent_t y0, hd_hw_extent_t width, hd_hw_extent_t height );	// Defaults to the whole screen
+	void setFrameRate( uint16_t fps );		// 0 disables pacing and skipping
+	void setLoop( bool loop );				// Rewind the reader at the end of the data
+	void restart( void );					// Resets frame pacing, e.g. after pausing
+
+	ILI9341_STAT_t showFrame( void );		// Shows the frame that is due, ILI9341_STAT_Error at the end of the data
+	uint32_t play( uint32_t numFrames = 0 );	// Returns frames shown, 0 plays to the end
+
+	float getFps( void );
+	ILI9341_video_stats_t getStats( void );
+	void resetStats( void );
+};
+
+#endif /* HPYERDISPLAY_ILI9341_VIDEOPLAYER_H */